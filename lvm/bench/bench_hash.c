@@ -0,0 +1,257 @@
+// Compares the crc32c, hash64 and find8 instructions against the equivalent bytecode loops.
+// cc -O2 -I../src bench_hash.c -o bench_hash -lm -lpthread
+
+#define LVM_IMPLEMENTATION
+#include "lvm.h"
+
+#include <time.h>
+
+#define BENCH_DATA_SIZE (64 * 1024)
+#define BENCH_TABLE_ADDR BENCH_DATA_SIZE
+#define BENCH_VAR_I (BENCH_TABLE_ADDR + 256 * 4)
+#define BENCH_VAR_ACC (BENCH_VAR_I + 8)
+#define BENCH_MEMORY_SIZE (BENCH_VAR_ACC + 8)
+#define BENCH_RUNS 20
+#define BENCH_NEEDLE 0xFF
+#define BENCH_FNV_PRIME 0x100000001B3ULL
+
+typedef struct {
+    lvm_Inst insts[64];
+    size_t count;
+} Bench_Code;
+
+static void emit(Bench_Code *code, lvm_InstType type, uint64_t operand) {
+    assert(code->count < ARRAY_SIZE(code->insts));
+
+    code->insts[code->count++] = (lvm_Inst){ .type = type, .operand = { .as_u64 = operand } };
+}
+
+static void emit_push_var(Bench_Code *code, uint64_t addr) {
+    emit(code, LVM_INST_PUSH, addr);
+    emit(code, LVM_INST_READ64, 0);
+}
+
+// NOTE: Emits `if (!(i < BENCH_DATA_SIZE)) goto end` and returns the index of the jump target to patch
+static size_t emit_loop_cond(Bench_Code *code) {
+    emit(code, LVM_INST_PUSH, BENCH_DATA_SIZE);
+    emit_push_var(code, BENCH_VAR_I);
+    emit(code, LVM_INST_STU, 0);
+    emit(code, LVM_INST_PUSH, 0);
+    emit(code, LVM_INST_JZ, 0);
+
+    return code->count - 2;
+}
+
+static void emit_loop_next(Bench_Code *code, size_t loop) {
+    emit(code, LVM_INST_PUSH, BENCH_VAR_I);
+    emit_push_var(code, BENCH_VAR_I);
+    emit(code, LVM_INST_INCI, 0);
+    emit(code, LVM_INST_WRITE64, 0);
+    emit(code, LVM_INST_PUSH, loop);
+    emit(code, LVM_INST_JMP, 0);
+}
+
+static void emit_init(Bench_Code *code, uint64_t acc) {
+    emit(code, LVM_INST_PUSH, BENCH_VAR_I);
+    emit(code, LVM_INST_PUSH, 0);
+    emit(code, LVM_INST_WRITE64, 0);
+    emit(code, LVM_INST_PUSH, BENCH_VAR_ACC);
+    emit(code, LVM_INST_PUSH, acc);
+    emit(code, LVM_INST_WRITE64, 0);
+}
+
+// crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8)
+static void build_crc32c_loop(Bench_Code *code) {
+    emit_init(code, 0xFFFFFFFF);
+
+    size_t loop = code->count;
+    size_t end = emit_loop_cond(code);
+
+    emit(code, LVM_INST_PUSH, BENCH_VAR_ACC);
+    emit_push_var(code, BENCH_VAR_I);
+    emit(code, LVM_INST_READ8, 0);
+    emit_push_var(code, BENCH_VAR_ACC);
+    emit(code, LVM_INST_XOR, 0);
+    emit(code, LVM_INST_PUSH, 0xFF);
+    emit(code, LVM_INST_ANDB, 0);
+    emit(code, LVM_INST_PUSH, 4);
+    emit(code, LVM_INST_MULTI, 0);
+    emit(code, LVM_INST_PUSH, BENCH_TABLE_ADDR);
+    emit(code, LVM_INST_ADDI, 0);
+    emit(code, LVM_INST_READ32, 0);
+    emit(code, LVM_INST_PUSH, 8);
+    emit_push_var(code, BENCH_VAR_ACC);
+    emit(code, LVM_INST_SHR, 0);
+    emit(code, LVM_INST_XOR, 0);
+    emit(code, LVM_INST_WRITE64, 0);
+    emit_loop_next(code, loop);
+
+    code->insts[end].operand.as_u64 = code->count;
+    emit_push_var(code, BENCH_VAR_ACC);
+    emit(code, LVM_INST_PUSH, 0xFFFFFFFF);
+    emit(code, LVM_INST_XOR, 0);
+    emit(code, LVM_INST_HLT, 0);
+}
+
+// hash = (hash ^ data[i]) * FNV_PRIME
+static void build_fnv_loop(Bench_Code *code) {
+    emit_init(code, 0xCBF29CE484222325ULL);
+
+    size_t loop = code->count;
+    size_t end = emit_loop_cond(code);
+
+    emit(code, LVM_INST_PUSH, BENCH_VAR_ACC);
+    emit_push_var(code, BENCH_VAR_ACC);
+    emit_push_var(code, BENCH_VAR_I);
+    emit(code, LVM_INST_READ8, 0);
+    emit(code, LVM_INST_XOR, 0);
+    emit(code, LVM_INST_PUSH, BENCH_FNV_PRIME);
+    emit(code, LVM_INST_MULTI, 0);
+    emit(code, LVM_INST_WRITE64, 0);
+    emit_loop_next(code, loop);
+
+    code->insts[end].operand.as_u64 = code->count;
+    emit_push_var(code, BENCH_VAR_ACC);
+    emit(code, LVM_INST_HLT, 0);
+}
+
+// for (i = 0; i < size; i++) if (data[i] == NEEDLE) return i; return -1;
+static void build_find_loop(Bench_Code *code) {
+    emit_init(code, 0);
+
+    size_t loop = code->count;
+    size_t end = emit_loop_cond(code);
+
+    emit_push_var(code, BENCH_VAR_I);
+    emit(code, LVM_INST_READ8, 0);
+    emit(code, LVM_INST_PUSH, BENCH_NEEDLE);
+    emit(code, LVM_INST_EQ, 0);
+    emit(code, LVM_INST_PUSH, 0);
+    size_t found = code->count - 1;
+    emit(code, LVM_INST_JNZ, 0);
+    emit_loop_next(code, loop);
+
+    code->insts[end].operand.as_u64 = code->count;
+    emit(code, LVM_INST_PUSH, (uint64_t)-1);
+    emit(code, LVM_INST_HLT, 0);
+
+    code->insts[found].operand.as_u64 = code->count;
+    emit_push_var(code, BENCH_VAR_I);
+    emit(code, LVM_INST_HLT, 0);
+}
+
+static void build_native(Bench_Code *code, lvm_InstType type, uint64_t operand) {
+    emit(code, LVM_INST_PUSH, 0);
+    emit(code, LVM_INST_PUSH, BENCH_DATA_SIZE);
+
+    if (type == LVM_INST_FIND8) {
+        emit(code, LVM_INST_PUSH, BENCH_NEEDLE);
+    }
+
+    emit(code, type, operand);
+    emit(code, LVM_INST_HLT, 0);
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint64_t bench(const char *name, lvm_Machine *machine, const Bench_Code *code, const uint8_t *memory) {
+    lvm_Program program = lvm_create_program(code->insts, code->count, memory, BENCH_MEMORY_SIZE);
+    double total = 0.0;
+    uint64_t result = 0;
+
+    for (size_t i = 0; i < BENCH_RUNS; i++) {
+        lvm_machine_load_program(machine, program);
+
+        double start = now_seconds();
+        lvm_Trap trap = lvm_machine_run(machine, -1);
+        total += now_seconds() - start;
+
+        if (trap != LVM_TRAP_OK || machine->stack_top != 1) {
+            fprintf(stderr, "ERROR: %s trapped: %s\n", name, lvm_get_trap_name(trap));
+            exit(1);
+        }
+
+        result = machine->stack[0].as_u64;
+    }
+
+    double seconds = total / BENCH_RUNS;
+    printf("%-16s %10.3f us %10.2f MB/s  result=%016"PRIx64"\n",
+        name, seconds * 1e6, BENCH_DATA_SIZE / seconds / 1e6, result);
+
+    return result;
+}
+
+int main(void) {
+    static uint8_t memory[BENCH_MEMORY_SIZE];
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+    for (size_t i = 0; i < BENCH_DATA_SIZE; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        memory[i] = (uint8_t)((state >> 33) % BENCH_NEEDLE);
+    }
+
+    memory[BENCH_DATA_SIZE - 3] = BENCH_NEEDLE;
+
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+        }
+
+        memcpy(&memory[BENCH_TABLE_ADDR + i * 4], &crc, 4);
+    }
+
+    lvm_Machine *machine = lvm_create_machine();
+    Bench_Code code;
+
+    printf("%d bytes, average of %d runs\n", BENCH_DATA_SIZE, BENCH_RUNS);
+
+    code.count = 0;
+    build_crc32c_loop(&code);
+    uint64_t crc_loop = bench("crc32c bytecode", machine, &code, memory);
+
+    code.count = 0;
+    build_native(&code, LVM_INST_CRC32C, 0);
+    uint64_t crc_inst = bench("crc32c inst", machine, &code, memory);
+
+    code.count = 0;
+    build_fnv_loop(&code);
+    bench("fnv1a bytecode*", machine, &code, memory);
+
+    code.count = 0;
+    build_native(&code, LVM_INST_HASH64, 0);
+    uint64_t hash_inst = bench("hash64 inst", machine, &code, memory);
+
+    code.count = 0;
+    build_find_loop(&code);
+    uint64_t find_loop = bench("find bytecode", machine, &code, memory);
+
+    code.count = 0;
+    build_native(&code, LVM_INST_FIND8, 0);
+    uint64_t find_inst = bench("find8 inst", machine, &code, memory);
+
+    printf("* FNV-1a is the byte loop scripts use today, not XXH64: compare the cost, not the result\n");
+
+    free(machine);
+
+    if (crc_loop != crc_inst || find_loop != find_inst) {
+        fprintf(stderr, "ERROR: bytecode and instruction results differ\n");
+        return 1;
+    }
+
+    // NOTE: Reference values from the xxHash test vectors
+    if (lvm_hash64((const uint8_t *)"", 0, 0) != 0xEF46DB3751D8E999ULL ||
+        lvm_hash64((const uint8_t *)"a", 1, 0) != 0xD24EC4F1A98C6E5BULL ||
+        hash_inst != lvm_hash64(memory, BENCH_DATA_SIZE, 0)) {
+        fprintf(stderr, "ERROR: hash64 doesn't match XXH64\n");
+        return 1;
+    }
+
+    return 0;
+}
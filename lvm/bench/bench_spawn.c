@@ -0,0 +1,128 @@
+// Measures how a fixed amount of guest work scales when split across spawned child machines.
+// cc -O2 -I../src bench_spawn.c -o bench_spawn -lm -lpthread
+
+#define LVM_IMPLEMENTATION
+#include "lvm.h"
+
+#include <time.h>
+
+#define BENCH_TOTAL_ITERS (1 << 24)
+#define BENCH_OUT_ADDR 0
+#define BENCH_LCG_MULT 6364136223846793005ULL
+
+typedef struct {
+    lvm_Inst insts[64];
+    size_t count;
+} Bench_Code;
+
+static void emit(Bench_Code *code, lvm_InstType type, uint64_t operand) {
+    assert(code->count < ARRAY_SIZE(code->insts));
+
+    code->insts[code->count++] = (lvm_Inst){ .type = type, .operand = { .as_u64 = operand } };
+}
+
+// NOTE: The parent spawns CHILDREN machines and joins them, child i runs
+//       `acc = 0; for (k = iters; k != 0; k--) acc = acc * LCG_MULT + k;` and writes acc to OUT_ADDR + i * 8
+static void build_program(Bench_Code *code, uint64_t children, uint64_t iters) {
+    emit(code, LVM_INST_PUSH, 0);
+    size_t entry = code->count - 1;
+    emit(code, LVM_INST_PUSH, children);
+    emit(code, LVM_INST_PUSH, BENCH_OUT_ADDR);
+    emit(code, LVM_INST_PUSH, 8);
+    emit(code, LVM_INST_SPAWN, 0);
+    emit(code, LVM_INST_JOIN, 0);
+    emit(code, LVM_INST_HLT, 0);
+
+    code->insts[entry].operand.as_u64 = code->count;
+    emit(code, LVM_INST_PUSH, iters);               // i k
+    emit(code, LVM_INST_PUSH, 0);                   // i k acc
+
+    size_t loop = code->count;
+    emit(code, LVM_INST_PUSH, BENCH_LCG_MULT);
+    emit(code, LVM_INST_MULTI, 0);                  // i k acc*m
+    emit(code, LVM_INST_SWAP, 0);                   // i acc*m k
+    emit(code, LVM_INST_DUP, 0);                    // i acc*m k k
+    emit(code, LVM_INST_SWAP, 1);                   // i k k acc*m
+    emit(code, LVM_INST_ADDI, 0);                   // i k acc
+    emit(code, LVM_INST_SWAP, 0);                   // i acc k
+    emit(code, LVM_INST_DECI, 0);                   // i acc k-1
+    emit(code, LVM_INST_DUP, 0);                    // i acc k-1 k-1
+    emit(code, LVM_INST_PUSH, 0);
+    size_t next = code->count - 1;
+    emit(code, LVM_INST_JNZ, 0);                    // i acc 0
+
+    emit(code, LVM_INST_POP, 0);                    // i acc
+    emit(code, LVM_INST_SWAP, 0);                   // acc i
+    emit(code, LVM_INST_PUSH, 8);
+    emit(code, LVM_INST_MULTI, 0);
+    emit(code, LVM_INST_PUSH, BENCH_OUT_ADDR);
+    emit(code, LVM_INST_ADDI, 0);                   // acc addr
+    emit(code, LVM_INST_SWAP, 0);                   // addr acc
+    emit(code, LVM_INST_WRITE64, 0);
+    emit(code, LVM_INST_HLT, 0);
+
+    code->insts[next].operand.as_u64 = code->count;
+    emit(code, LVM_INST_SWAP, 0);                   // i k-1 acc
+    emit(code, LVM_INST_PUSH, loop);
+    emit(code, LVM_INST_JMP, 0);
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+int main(void) {
+    lvm_Machine *machine = lvm_create_machine();
+    size_t max_children = lvm_hardware_threads() * 2;
+    double base = 0.0;
+
+    printf("%d guest loop iterations split across children\n", BENCH_TOTAL_ITERS);
+    printf("%8s %12s %10s %14s\n", "children", "ms", "speedup", "child insts");
+
+    for (size_t children = 1; children <= max_children && children <= LVM_SPAWN_MAX; children *= 2) {
+        uint64_t iters = BENCH_TOTAL_ITERS / children;
+        Bench_Code code = {0};
+
+        build_program(&code, children, iters);
+        lvm_machine_load_program(machine, lvm_create_program(code.insts, code.count, NULL, 0));
+
+        double start = now_seconds();
+        lvm_Trap trap = lvm_machine_run(machine, -1);
+        double seconds = now_seconds() - start;
+
+        if (trap != LVM_TRAP_OK) {
+            fprintf(stderr, "ERROR: %zu children trapped: %s\n", children, lvm_get_trap_name(trap));
+            return 1;
+        }
+
+        uint64_t expected = 0;
+
+        for (uint64_t k = iters; k != 0; k--) {
+            expected = expected * BENCH_LCG_MULT + k;
+        }
+
+        for (size_t i = 0; i < children; i++) {
+            uint64_t result;
+            memcpy(&result, &machine->memory[BENCH_OUT_ADDR + i * 8], sizeof(result));
+
+            if (result != expected) {
+                fprintf(stderr, "ERROR: child %zu of %zu returned %016"PRIx64", expected %016"PRIx64"\n",
+                    i, children, result, expected);
+                return 1;
+            }
+        }
+
+        if (children == 1) {
+            base = seconds;
+        }
+
+        printf("%8zu %12.2f %9.2fx %14"PRIu64"\n", children, seconds * 1e3, base / seconds, machine->spawned_insts);
+    }
+
+    lvm_destroy_machine(machine);
+
+    return 0;
+}
@@ -3,6 +3,13 @@
 #ifndef _LVM_H_
 #define _LVM_H_
 
+// NOTE: The perf layer needs syscall(), which glibc only declares with _DEFAULT_SOURCE. This only takes
+//       effect when lvm.h is the first include of the implementation file, otherwise define
+//       _DEFAULT_SOURCE (or _GNU_SOURCE) before any include or build with LVM_NO_PERF.
+#if defined(LVM_IMPLEMENTATION) && defined(__linux__) && !defined(LVM_NO_PERF) && !defined(_DEFAULT_SOURCE) && !defined(_GNU_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -18,6 +25,12 @@
 #define LVM_STACK_MAX 1024LL
 #define LVM_MEMORY_MAX (640 * 1000)
 #define LVM_NATIVE_MAX 1024LL
+#define LVM_SPAWN_MAX 256
+
+// NOTE: Number of host threads running spawned machines, 0 means one per hardware thread
+#ifndef LVM_SPAWN_WORKERS
+#define LVM_SPAWN_WORKERS 0
+#endif
 
 typedef union {
     int64_t as_i64;
@@ -39,83 +52,108 @@ typedef enum {
     LVM_TRAP_STACK_UNDERFLOW,
     LVM_TRAP_DIV_BY_ZERO,
     LVM_TRAP_ILLEGAL_MEMORY_ACCESS,
+    LVM_TRAP_ILLEGAL_SPAWN,
+    LVM_TRAP_SPAWN_LIMIT,
     LVM_MAX_TRAPS,
 } lvm_Trap;
 
+// NOTE: The instruction set is described once here, everything else (the opcodes, names,
+//       stack arity and handlers) is generated from it.
+//       X(OPCODE, NAME, POPS, PUSHES, HAS_OPERAND, VARIABLE_EFFECT, KIND, A, B, C)
+//       POPS and PUSHES are the fixed stack effect of the instruction. VARIABLE_EFFECT marks the
+//       ones whose real effect isn't known statically (swap reads operand + 2 slots deep, a native
+//       may do anything to the stack), for those POPS and PUSHES are only the part done by the VM.
+//       KIND is the handler template that executes it and A, B, C are the types/operator it's
+//       instantiated with.
+//       The row index is the opcode: new instructions are only ever appended so existing encodings stay valid.
+//       The _Static_asserts after lvm_insts_info pin the existing encodings.
+// TODO: ADD ROTATE SHIFT INSTS (ROTL, ROTR)
+#define LVM_INST_LIST(X) \
+    X(ILLEGAL,     "illegal",     0, 0, false, false, ILLEGAL,     _,        _,   _)                   \
+    X(NOP,         "nop",         0, 0, false, false, NOP,         _,        _,   _)                   \
+    X(PUSH,        "push",        0, 1, true,  false, PUSH,        _,        _,   _)                   \
+    X(POP,         "pop",         1, 0, false, false, POP,         _,        _,   _)                   \
+    X(DUP,         "dup",         1, 2, false, false, DUP,         _,        _,   _)                   \
+    X(SWAP,        "swap",        2, 2, true,  true,  SWAP,        _,        _,   _)                   \
+    X(INCI,        "inci",        1, 1, false, false, UNARY,       i64,      i64, ++)                  \
+    X(INCF,        "incf",        1, 1, false, false, UNARY,       f64,      f64, ++)                  \
+    X(DECI,        "deci",        1, 1, false, false, UNARY,       i64,      i64, --)                  \
+    X(DECF,        "decf",        1, 1, false, false, UNARY,       f64,      f64, --)                  \
+    X(ADDI,        "addi",        2, 1, false, false, BINARY,      i64,      i64, +)                   \
+    X(ADDF,        "addf",        2, 1, false, false, BINARY,      f64,      f64, +)                   \
+    X(SUBI,        "subi",        2, 1, false, false, BINARY,      i64,      i64, -)                   \
+    X(SUBF,        "subf",        2, 1, false, false, BINARY,      f64,      f64, -)                   \
+    X(MULTI,       "multi",       2, 1, false, false, BINARY,      i64,      i64, *)                   \
+    X(MULTF,       "multf",       2, 1, false, false, BINARY,      f64,      f64, *)                   \
+    X(DIVI,        "divi",        2, 1, false, false, BINARY,      i64,      i64, /)                   \
+    X(DIVU,        "divu",        2, 1, false, false, BINARY,      u64,      u64, /)                   \
+    X(DIVF,        "divf",        2, 1, false, false, BINARY,      f64,      f64, /)                   \
+    X(MODI,        "modi",        2, 1, false, false, BINARY,      i64,      i64, %)                   \
+    X(MODU,        "modu",        2, 1, false, false, BINARY,      u64,      u64, %)                   \
+    X(MODF,        "modf",        2, 1, false, false, BINARY_FN,   f64,      f64, fmod)                \
+    X(EQ,          "eq",          2, 1, false, false, BINARY,      u64,      u64, ==)                  \
+    X(NEQ,         "neq",         2, 1, false, false, BINARY,      u64,      u64, !=)                  \
+    X(GTI,         "gti",         2, 1, false, false, BINARY,      u64,      i64, >)                   \
+    X(GTU,         "gtu",         2, 1, false, false, BINARY,      u64,      u64, >)                   \
+    X(GTF,         "gtf",         2, 1, false, false, BINARY,      u64,      f64, >)                   \
+    X(GEI,         "gei",         2, 1, false, false, BINARY,      u64,      i64, >=)                  \
+    X(GEU,         "geu",         2, 1, false, false, BINARY,      u64,      u64, >=)                  \
+    X(GEF,         "gef",         2, 1, false, false, BINARY,      u64,      f64, >=)                  \
+    X(STI,         "sti",         2, 1, false, false, BINARY,      u64,      i64, <)                   \
+    X(STU,         "stu",         2, 1, false, false, BINARY,      u64,      u64, <)                   \
+    X(STF,         "stf",         2, 1, false, false, BINARY,      u64,      f64, <)                   \
+    X(SEI,         "sei",         2, 1, false, false, BINARY,      u64,      i64, <=)                  \
+    X(SEU,         "seu",         2, 1, false, false, BINARY,      u64,      u64, <=)                  \
+    X(SEF,         "sef",         2, 1, false, false, BINARY,      u64,      f64, <=)                  \
+    X(AND,         "and",         2, 1, false, false, BINARY,      u64,      u64, &&)                  \
+    X(NOT,         "not",         1, 1, false, false, UNARY,       u64,      u64, !)                   \
+    X(OR,          "or",          2, 1, false, false, BINARY,      u64,      u64, ||)                  \
+    X(ANDB,        "andb",        2, 1, false, false, BINARY,      u64,      u64, &)                   \
+    X(NOTB,        "notb",        1, 1, false, false, UNARY,       u64,      u64, ~)                   \
+    X(ORB,         "orb",         2, 1, false, false, BINARY,      u64,      u64, |)                   \
+    X(XOR,         "xor",         2, 1, false, false, BINARY,      u64,      u64, ^)                   \
+    X(SHL,         "shl",         2, 1, false, false, BINARY,      u64,      u64, <<)                  \
+    X(SHR,         "shr",         2, 1, false, false, BINARY,      u64,      u64, >>)                  \
+    X(CALL,        "call",        1, 1, false, false, CALL,        _,        _,   _)                   \
+    X(NATIVE,      "native",      1, 0, false, true,  NATIVE,      _,        _,   _)                   \
+    X(RETURN,      "return",      1, 0, false, false, JMP,         _,        _,   _)                   \
+    X(JMP,         "jmp",         1, 0, false, false, JMP,         _,        _,   _)                   \
+    X(JZ,          "jz",          2, 0, false, false, JMP_IF,      _,        _,   !)                   \
+    X(JNZ,         "jnz",         2, 0, false, false, JMP_IF,      _,        _,   !!)                  \
+    X(I2F,         "i2f",         1, 1, false, false, CAST,        i64,      f64, (double))            \
+    X(U2F,         "u2f",         1, 1, false, false, CAST,        u64,      f64, (double))            \
+    X(F2I,         "f2i",         1, 1, false, false, CAST,        f64,      i64, (int64_t))           \
+    X(F2U,         "f2u",         1, 1, false, false, CAST,        f64,      u64, (uint64_t)(int64_t)) \
+    X(READ8,       "read8",       1, 1, false, false, READ,        uint8_t,  _,   _)                   \
+    X(READ16,      "read16",      1, 1, false, false, READ,        uint16_t, _,   _)                   \
+    X(READ32,      "read32",      1, 1, false, false, READ,        uint32_t, _,   _)                   \
+    X(READ64,      "read64",      1, 1, false, false, READ,        uint64_t, _,   _)                   \
+    X(WRITE8,      "write8",      2, 0, false, false, WRITE,       uint8_t,  _,   _)                   \
+    X(WRITE16,     "write16",     2, 0, false, false, WRITE,       uint16_t, _,   _)                   \
+    X(WRITE32,     "write32",     2, 0, false, false, WRITE,       uint32_t, _,   _)                   \
+    X(WRITE64,     "write64",     2, 0, false, false, WRITE,       uint64_t, _,   _)                   \
+    X(HLT,         "hlt",         0, 0, false, false, HLT,         _,        _,   _)                   \
+    X(PRINT_DEBUG, "print_debug", 1, 0, false, false, PRINT_DEBUG, _,        _,   _)                   \
+    X(CRC32C,      "crc32c",      2, 1, true,  false, RANGE,       crc32c,   _,   _)                   \
+    X(HASH64,      "hash64",      2, 1, true,  false, RANGE,       hash64,   _,   _)                   \
+    X(FIND8,       "find8",       3, 1, false, false, FIND,        _,        _,   _)                   \
+    X(SPAWN,       "spawn",       4, 0, true,  false, SPAWN,       _,        _,   _)                   \
+    X(JOIN,        "join",        0, 0, false, false, JOIN,        _,        _,   _)
+
 typedef enum {
-    LVM_INST_ILLEGAL = 0,
-    LVM_INST_NOP,
-    LVM_INST_PUSH,
-    LVM_INST_POP,
-    LVM_INST_DUP,
-    LVM_INST_SWAP,
-    LVM_INST_INCI,
-    LVM_INST_INCF,
-    LVM_INST_DECI,
-    LVM_INST_DECF,
-    LVM_INST_ADDI,
-    LVM_INST_ADDF,
-    LVM_INST_SUBI,
-    LVM_INST_SUBF,
-    LVM_INST_MULTI,
-    LVM_INST_MULTF,
-    LVM_INST_DIVI,
-    LVM_INST_DIVU,
-    LVM_INST_DIVF,
-    LVM_INST_MODI,
-    LVM_INST_MODU,
-    LVM_INST_MODF,
-    LVM_INST_EQ,
-    LVM_INST_NEQ,
-    LVM_INST_GTI,
-    LVM_INST_GTU,
-    LVM_INST_GTF,
-    LVM_INST_GEI,
-    LVM_INST_GEU,
-    LVM_INST_GEF,
-    LVM_INST_STI,
-    LVM_INST_STU,
-    LVM_INST_STF,
-    LVM_INST_SEI,
-    LVM_INST_SEU,
-    LVM_INST_SEF,
-    LVM_INST_AND,
-    LVM_INST_NOT,
-    LVM_INST_OR,
-    LVM_INST_ANDB,
-    LVM_INST_NOTB,
-    LVM_INST_ORB,
-    LVM_INST_XOR,
-    LVM_INST_SHL,
-    LVM_INST_SHR,
-    // TODO: ADD ROTATE SHIFT INSTS
-    // LVM_INST_ROTL,
-    // LVM_INST_ROTR,
-    LVM_INST_CALL,
-    LVM_INST_NATIVE,
-    LVM_INST_RETURN,
-    LVM_INST_JMP,
-    LVM_INST_JZ,
-    LVM_INST_JNZ,
-    LVM_INST_I2F,
-    LVM_INST_U2F,
-    LVM_INST_F2I,
-    LVM_INST_F2U,
-    LVM_INST_READ8,
-    LVM_INST_READ16,
-    LVM_INST_READ32,
-    LVM_INST_READ64,
-    LVM_INST_WRITE8,
-    LVM_INST_WRITE16,
-    LVM_INST_WRITE32,
-    LVM_INST_WRITE64,
-    LVM_INST_HLT,
-    LVM_INST_PRINT_DEBUG,
+#define X(OPCODE, ...) LVM_INST_##OPCODE,
+    LVM_INST_LIST(X)
+#undef X
     LVM_MAX_INSTS,
 } lvm_InstType;
 
-// TODO: FIX STATIC ASSERT
-// static_assert (LVM_MAX_INSTS == 65, "THE INSTRUCTION SET CHANGED PLEASE UPDATE THE CODE");
+typedef struct {
+    const char *name;
+    uint8_t pops;
+    uint8_t pushes;
+    bool has_operand;
+    bool variable_effect;
+} lvm_InstInfo;
 
 typedef struct {
     lvm_InstType type;
@@ -131,6 +169,8 @@ typedef struct {
 } lvm_Program;
 
 typedef struct lvm_Machine lvm_Machine;
+typedef struct lvm_SpawnGroup lvm_SpawnGroup;
+typedef struct lvm_CachedProgram lvm_CachedProgram;
 
 typedef lvm_Trap(*lvm_Native)(lvm_Machine *machine);
 
@@ -144,18 +184,78 @@ struct lvm_Machine {
     size_t natives_top;
 
     lvm_Program program;
+    lvm_CachedProgram *cached;
     
     lvm_OpAddr ip;
     bool hlt;
+
+    lvm_SpawnGroup *spawn;
+    // NOTE: Instructions executed by every joined child (and their own children) since the program was loaded
+    uint64_t spawned_insts;
 };
 
 LVM_API const char *lvm_get_trap_name(lvm_Trap trap);
 LVM_API const char *lvm_get_inst_name(lvm_InstType inst);
+LVM_API const lvm_InstInfo *lvm_get_inst_info(lvm_InstType inst);
 LVM_API lvm_Program lvm_create_program(const lvm_Inst *const insts, size_t insts_count, const uint8_t *const memory, size_t memory_size);
 LVM_API lvm_Machine *lvm_create_machine(void);
+LVM_API void lvm_destroy_machine(lvm_Machine *machine);
 LVM_API void lvm_machine_load_program(lvm_Machine *machine, lvm_Program program);
+LVM_API void lvm_machine_load_cached_program(lvm_Machine *machine, lvm_CachedProgram *cached);
 void lvm_dump_stack(const lvm_Machine *const lvm, FILE *stream);
 LVM_API lvm_Trap lvm_machine_run(lvm_Machine *machine, int64_t limit);
+LVM_API uint32_t lvm_crc32c(const uint8_t *data, size_t size, uint32_t crc);
+LVM_API uint64_t lvm_hash64(const uint8_t *data, size_t size, uint64_t seed);
+
+// NOTE: The program cache is process-wide and thread-safe. An entry owns an immutable copy
+//       of the program, is shared between every machine that acquired it and stays alive
+//       until its last reference is released, even after it has been evicted.
+//       A machine loaded with lvm_machine_load_cached_program holds its own reference, so the
+//       caller may release its reference right after loading.
+//       Acquiring hashes and compares the whole program, even on a hit. Hosts that reload the same
+//       program often should keep the handle and pass it to lvm_machine_load_cached_program instead.
+#ifndef LVM_PROGRAM_CACHE_LIMIT
+#define LVM_PROGRAM_CACHE_LIMIT (64 * 1024 * 1024)
+#endif
+#define LVM_PROGRAM_CACHE_BUCKETS 256
+
+LVM_API uint64_t lvm_program_hash(lvm_Program program);
+LVM_API lvm_CachedProgram *lvm_program_cache_acquire(lvm_Program program);
+LVM_API lvm_CachedProgram *lvm_program_cache_retain(lvm_CachedProgram *cached);
+LVM_API void lvm_program_cache_release(lvm_CachedProgram *cached);
+LVM_API lvm_Program lvm_cached_program_get(const lvm_CachedProgram *cached);
+LVM_API void lvm_program_cache_set_limit(size_t limit);
+LVM_API void lvm_program_cache_clear(void);
+
+// NOTE: The perf layer wraps lvm_machine_run with host hardware counters (Linux perf_event_open).
+//       When a counter can't be opened (other OS, no PMU, perf_event_paranoid) it's marked as
+//       unavailable and the program still runs normally.
+//       The counters only cover the calling thread: children started by spawn are counted in child_insts,
+//       but the host work they do on pool threads isn't measured (the part the caller runs itself while
+//       it waits in join is), so the per instruction ratios are only exact for runs that don't spawn.
+typedef enum {
+    LVM_PERF_CYCLES,
+    LVM_PERF_INSTRUCTIONS,
+    LVM_PERF_BRANCH_MISSES,
+    LVM_PERF_L1D_MISSES,
+    LVM_PERF_LLC_MISSES,
+    LVM_MAX_PERF_COUNTERS,
+} lvm_PerfCounter;
+
+typedef struct {
+    lvm_Trap trap;
+    uint64_t guest_insts;
+    uint64_t child_insts;
+
+    uint64_t values[LVM_MAX_PERF_COUNTERS];
+    bool available[LVM_MAX_PERF_COUNTERS];
+} lvm_PerfReport;
+
+LVM_API const char *lvm_get_perf_counter_name(lvm_PerfCounter counter);
+LVM_API lvm_Trap lvm_machine_run_perf(lvm_Machine *machine, int64_t limit, lvm_PerfReport *report);
+LVM_API double lvm_perf_per_guest_inst(const lvm_PerfReport *report, lvm_PerfCounter counter);
+LVM_API void lvm_perf_dump_csv_header(FILE *stream);
+LVM_API void lvm_perf_dump_csv(const lvm_PerfReport *report, FILE *stream);
 
 #ifdef LVM_IMPLEMENTATION
 
@@ -168,10 +268,77 @@ LVM_API lvm_Trap lvm_machine_run(lvm_Machine *machine, int64_t limit);
 #include <math.h>
 #include <assert.h>
 #include <errno.h>
+#include <stdatomic.h>
+
+#ifdef _WIN32
+#include <windows.h>
+
+typedef SRWLOCK lvm_Mutex;
+#define LVM_MUTEX_INIT SRWLOCK_INIT
+#define lvm_mutex_lock(MUTEX_P) AcquireSRWLockExclusive((MUTEX_P))
+#define lvm_mutex_unlock(MUTEX_P) ReleaseSRWLockExclusive((MUTEX_P))
+
+typedef CONDITION_VARIABLE lvm_Cond;
+#define LVM_COND_INIT CONDITION_VARIABLE_INIT
+#define lvm_cond_wait(COND_P, MUTEX_P) SleepConditionVariableSRW((COND_P), (MUTEX_P), INFINITE, 0)
+#define lvm_cond_broadcast(COND_P) WakeAllConditionVariable((COND_P))
+
+#define LVM_THREAD_FN(NAME) DWORD WINAPI NAME(LPVOID arg)
+
+static inline void lvm_thread_start(LPTHREAD_START_ROUTINE fn) {
+    HANDLE thread = CreateThread(NULL, 0, fn, NULL, 0, NULL);
+
+    if (thread != NULL) {
+        CloseHandle(thread);
+    }
+}
+
+static inline size_t lvm_hardware_threads(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+
+    return info.dwNumberOfProcessors;
+}
+#else
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_mutex_t lvm_Mutex;
+#define LVM_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+#define lvm_mutex_lock(MUTEX_P) pthread_mutex_lock((MUTEX_P))
+#define lvm_mutex_unlock(MUTEX_P) pthread_mutex_unlock((MUTEX_P))
+
+typedef pthread_cond_t lvm_Cond;
+#define LVM_COND_INIT PTHREAD_COND_INITIALIZER
+#define lvm_cond_wait(COND_P, MUTEX_P) pthread_cond_wait((COND_P), (MUTEX_P))
+#define lvm_cond_broadcast(COND_P) pthread_cond_broadcast((COND_P))
+
+#define LVM_THREAD_FN(NAME) void *NAME(void *arg)
+
+static inline void lvm_thread_start(void *(*fn)(void *)) {
+    pthread_t thread;
+
+    if (pthread_create(&thread, NULL, fn, NULL) == 0) {
+        pthread_detach(thread);
+    }
+}
+
+static inline size_t lvm_hardware_threads(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
 
-// TODO: FIX STATIC ASSERT
-// static_assert (LVM_MAX_TRAPS == 8, "THE TRAPS HAS CHANGED PLEASE UPDATE THE CODE");
-const char *const lvm_traps_names[LVM_MAX_TRAPS] = {
+    return count > 0 ? (size_t)count : 1;
+}
+#endif
+
+#if defined(__linux__) && !defined(LVM_NO_PERF)
+#define LVM_HAS_PERF
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+const char *const lvm_traps_names[] = {
     [LVM_TRAP_OK]                    = "ok",
     [LVM_TRAP_ILLEGAL_INST]          = "illegal instruction",
     [LVM_TRAP_ILLEGAL_INST_ACCESS]   = "illegal instruction access",
@@ -180,82 +347,36 @@ const char *const lvm_traps_names[LVM_MAX_TRAPS] = {
     [LVM_TRAP_STACK_UNDERFLOW]       = "stack underflow",
     [LVM_TRAP_DIV_BY_ZERO]           = "div by zero",
     [LVM_TRAP_ILLEGAL_MEMORY_ACCESS] = "illegal memory access",
+    [LVM_TRAP_ILLEGAL_SPAWN]         = "illegal spawn",
+    [LVM_TRAP_SPAWN_LIMIT]           = "spawn limit exceeded",
+};
+
+_Static_assert(ARRAY_SIZE(lvm_traps_names) == LVM_MAX_TRAPS, "THE TRAPS HAS CHANGED PLEASE UPDATE THE CODE");
+
+const char *const lvm_insts_names[] = {
+#define X(OPCODE, NAME, ...) [LVM_INST_##OPCODE] = NAME,
+    LVM_INST_LIST(X)
+#undef X
 };
 
-// TODO: FIX STATIC ASSERT
-// static_assert (LVM_MAX_INSTS == 65, "THE INSTRUCTION SET CHANGED PLEASE UPDATE THE CODE");
-const char *const lvm_insts_names[LVM_MAX_INSTS] = {
-    [LVM_INST_ILLEGAL]     = "illegal",
-    [LVM_INST_NOP]         = "nop",
-    [LVM_INST_PUSH]        = "push",
-    [LVM_INST_POP]         = "pop",
-    [LVM_INST_DUP]         = "dup",
-    [LVM_INST_SWAP]        = "swap",
-    [LVM_INST_INCI]        = "inci",
-    [LVM_INST_INCF]        = "incf",
-    [LVM_INST_DECI]        = "deci",
-    [LVM_INST_DECF]        = "decf",
-    [LVM_INST_ADDI]        = "addi",
-    [LVM_INST_ADDF]        = "addf",
-    [LVM_INST_SUBI]        = "subi",
-    [LVM_INST_SUBF]        = "subf",
-    [LVM_INST_MULTI]       = "multi",
-    [LVM_INST_MULTF]       = "multf",
-    [LVM_INST_DIVI]        = "divi",
-    [LVM_INST_DIVU]        = "divu",
-    [LVM_INST_DIVF]        = "divf",
-    [LVM_INST_MODI]        = "modi",
-    [LVM_INST_MODU]        = "modu",
-    [LVM_INST_MODF]        = "modf",
-    [LVM_INST_EQ]          = "eq",
-    [LVM_INST_NEQ]         = "neq",
-    [LVM_INST_GTI]         = "gti",
-    [LVM_INST_GTU]         = "gtu",
-    [LVM_INST_GTF]         = "gtf",
-    [LVM_INST_GEI]         = "gei",
-    [LVM_INST_GEU]         = "geu",
-    [LVM_INST_GEF]         = "gef",
-    [LVM_INST_STI]         = "sti",
-    [LVM_INST_STU]         = "stu",
-    [LVM_INST_STF]         = "stf",
-    [LVM_INST_SEI]         = "sei",
-    [LVM_INST_SEU]         = "seu",
-    [LVM_INST_SEF]         = "sef",
-    [LVM_INST_AND]         = "and",
-    [LVM_INST_NOT]         = "not",
-    [LVM_INST_OR]          = "or",
-    [LVM_INST_ANDB]        = "andb",
-    [LVM_INST_NOTB]        = "notb",
-    [LVM_INST_ORB]         = "orb",
-    [LVM_INST_XOR]         = "xor",
-    [LVM_INST_SHL]         = "shl",
-    [LVM_INST_SHR]         = "shr",
-    [LVM_INST_CALL]        = "call",
-    [LVM_INST_NATIVE]      = "native",
-    [LVM_INST_RETURN]      = "return",
-    [LVM_INST_JMP]         = "jmp",
-    [LVM_INST_JZ]          = "jz",
-    [LVM_INST_JNZ]         = "jnz",
-    [LVM_INST_I2F]         = "i2f",
-    [LVM_INST_U2F]         = "u2f",
-    [LVM_INST_F2I]         = "f2i",
-    [LVM_INST_F2U]         = "f2u",
-    [LVM_INST_READ8]       = "read8",
-    [LVM_INST_READ16]      = "read16",
-    [LVM_INST_READ32]      = "read32",
-    [LVM_INST_READ64]      = "read64",
-    [LVM_INST_WRITE8]      = "write8",
-    [LVM_INST_WRITE16]     = "write16",
-    [LVM_INST_WRITE32]     = "write32",
-    [LVM_INST_WRITE64]     = "write64",
-    [LVM_INST_HLT]         = "hlt",
-    [LVM_INST_PRINT_DEBUG] = "print_debug",
+const lvm_InstInfo lvm_insts_info[] = {
+#define X(OPCODE, NAME, POPS, PUSHES, HAS_OPERAND, VARIABLE_EFFECT, ...) [LVM_INST_##OPCODE] = { NAME, POPS, PUSHES, HAS_OPERAND, VARIABLE_EFFECT },
+    LVM_INST_LIST(X)
+#undef X
 };
 
+// NOTE: Pins the last opcode of every release of the table, a row inserted anywhere before them shifts
+//       their encoding and fails here. Pin the last row of a new batch when appending it.
+_Static_assert(LVM_INST_HLT == 63 && LVM_INST_PRINT_DEBUG == 64, "THE INSTRUCTION ENCODINGS CHANGED, NEW INSTRUCTIONS MUST BE APPENDED");
+_Static_assert(LVM_INST_FIND8 == 67, "THE INSTRUCTION ENCODINGS CHANGED, NEW INSTRUCTIONS MUST BE APPENDED");
+_Static_assert(LVM_INST_JOIN == 69, "THE INSTRUCTION ENCODINGS CHANGED, NEW INSTRUCTIONS MUST BE APPENDED");
+
 LVM_API lvm_Trap lvm_machine_execute_inst(lvm_Machine *machine);
 LVM_API lvm_Trap lvm_machine_stack_push(lvm_Machine *machine, lvm_Word word);
 LVM_API lvm_Trap lvm_machine_stack_pop(lvm_Machine *machine, lvm_Word *word);
 LVM_API void lvm_machine_advance(lvm_Machine *machine);
+LVM_API lvm_Trap lvm_machine_spawn(lvm_Machine *machine, lvm_OpAddr entry, uint64_t count, lvm_MemAddr out_addr, uint64_t out_size, uint64_t limit);
+LVM_API lvm_Trap lvm_machine_join(lvm_Machine *machine, uint64_t *insts);
 
 #define lvm_Machine_Stack_Push(MACHINE_P, WORD) do { lvm_Trap __MACRO__TRAP__ = lvm_machine_stack_push((MACHINE_P), (WORD)); if (LVM_TRAP_OK != __MACRO__TRAP__) { return __MACRO__TRAP__; } } while (0)
 #define lvm_Machine_Stack_Pop(MACHINE_P, WORD_P) do { lvm_Trap __MACRO__TRAP__ = lvm_machine_stack_pop((MACHINE_P), (WORD_P)); if (LVM_TRAP_OK != __MACRO__TRAP__) { return __MACRO__TRAP__; } } while (0)
@@ -285,27 +406,242 @@ LVM_API void lvm_machine_advance(lvm_Machine *machine);
         lvm_Machine_Stack_Push((MACHINE_P), __MACRO__RESULT__);                       \
     } while (0)
 
-#define lvm_Memory_Read_Inst(MACHINE_P, TYPE)                                                                 \
-    do {                                                                                                      \
-        lvm_Word __MACRO__ADDR__;                                                                             \
-        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__ADDR__);                                                 \
-        if (__MACRO__ADDR__.as_u64 >= LVM_MEMORY_MAX - (sizeof(TYPE) - 1)) {                                  \
-            return LVM_TRAP_ILLEGAL_MEMORY_ACCESS;                                                            \
-        }                                                                                                     \
-        lvm_Machine_Stack_Push((MACHINE_P), (lvm_Word){ .as_u64 = machine->memory[__MACRO__ADDR__.as_u64] }); \
+#define lvm_Binary_Fn_Inst(MACHINE_P, OUT_TYPE, IN_TYPE, FN)                                                        \
+    do {                                                                                                            \
+        lvm_Word __MACRO__A__;                                                                                      \
+        lvm_Word __MACRO__B__;                                                                                      \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__A__);                                                          \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__B__);                                                          \
+        lvm_Word __MACRO__RESULT__ = { .as_##OUT_TYPE = FN(__MACRO__A__.as_##IN_TYPE, __MACRO__B__.as_##IN_TYPE) }; \
+        lvm_Machine_Stack_Push((MACHINE_P), __MACRO__RESULT__);                                                     \
+    } while (0)
+
+// NOTE: Memory is accessed unaligned with memcpy, an access of SIZE bytes at ADDR is legal iff it fits entirely in memory
+static inline bool lvm_memory_in_bounds(lvm_MemAddr addr, uint64_t size) {
+    return size <= LVM_MEMORY_MAX && addr <= LVM_MEMORY_MAX - size;
+}
+
+#define lvm_Memory_Read_Inst(MACHINE_P, TYPE)                                                  \
+    do {                                                                                       \
+        lvm_Word __MACRO__ADDR__;                                                              \
+        TYPE __MACRO__VALUE__;                                                                 \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__ADDR__);                                  \
+        if (!lvm_memory_in_bounds(__MACRO__ADDR__.as_u64, sizeof(TYPE))) {                     \
+            return LVM_TRAP_ILLEGAL_MEMORY_ACCESS;                                             \
+        }                                                                                      \
+        memcpy(&__MACRO__VALUE__, &(MACHINE_P)->memory[__MACRO__ADDR__.as_u64], sizeof(TYPE)); \
+        lvm_Machine_Stack_Push((MACHINE_P), (lvm_Word){ .as_u64 = __MACRO__VALUE__ });         \
+    } while (0)
+
+#define lvm_Memory_Write_Inst(MACHINE_P, TYPE)                                                \
+    do {                                                                                      \
+        lvm_Word __MACRO__VALUE__;                                                            \
+        lvm_Word __MACRO__ADDR__;                                                             \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__VALUE__);                                \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__ADDR__);                                 \
+        if (!lvm_memory_in_bounds(__MACRO__ADDR__.as_u64, sizeof(TYPE))) {                    \
+            return LVM_TRAP_ILLEGAL_MEMORY_ACCESS;                                            \
+        }                                                                                     \
+        TYPE __MACRO__DATA__ = (TYPE)__MACRO__VALUE__.as_u64;                                 \
+        memcpy(&(MACHINE_P)->memory[__MACRO__ADDR__.as_u64], &__MACRO__DATA__, sizeof(TYPE)); \
+    } while (0)
+
+// NOTE: Handler templates, one per KIND of LVM_INST_LIST. A, B and C are the arguments given in the table
+//       (unused ones are `_`), every template either advances the ip, jumps or returns a trap
+#define lvm_Inst_Kind_ILLEGAL(MACHINE_P, INST, A, B, C) return LVM_TRAP_ILLEGAL_INST
+#define lvm_Inst_Kind_NOP(MACHINE_P, INST, A, B, C) lvm_machine_advance((MACHINE_P))
+#define lvm_Inst_Kind_HLT(MACHINE_P, INST, A, B, C) (MACHINE_P)->hlt = true
+
+#define lvm_Inst_Kind_PUSH(MACHINE_P, INST, A, B, C)         \
+    do {                                                     \
+        lvm_Machine_Stack_Push((MACHINE_P), (INST).operand); \
+        lvm_machine_advance((MACHINE_P));                    \
+    } while (0)
+
+#define lvm_Inst_Kind_POP(MACHINE_P, INST, A, B, C) \
+    do {                                            \
+        lvm_Machine_Stack_Pop((MACHINE_P), NULL);   \
+        lvm_machine_advance((MACHINE_P));           \
+    } while (0)
+
+#define lvm_Inst_Kind_DUP(MACHINE_P, INST, A, B, C)        \
+    do {                                                   \
+        lvm_Word __MACRO__A__;                             \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__A__); \
+        lvm_Machine_Stack_Push((MACHINE_P), __MACRO__A__); \
+        lvm_Machine_Stack_Push((MACHINE_P), __MACRO__A__); \
+        lvm_machine_advance((MACHINE_P));                  \
+    } while (0)
+
+#define lvm_Inst_Kind_SWAP(MACHINE_P, INST, A, B, C)                                                                            \
+    do {                                                                                                                        \
+        uint64_t __MACRO__DEPTH__ = (INST).operand.as_u64;                                                                      \
+        if ((MACHINE_P)->stack_top < 2 || (uint64_t)((MACHINE_P)->stack_top - 2 - __MACRO__DEPTH__) > (MACHINE_P)->stack_top) { \
+            return LVM_TRAP_STACK_UNDERFLOW;                                                                                    \
+        }                                                                                                                       \
+        lvm_Word __MACRO__A__;                                                                                                  \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__A__);                                                                      \
+        lvm_Word __MACRO__B__ = (MACHINE_P)->stack[(MACHINE_P)->stack_top - 1 - __MACRO__DEPTH__];                              \
+        (MACHINE_P)->stack[(MACHINE_P)->stack_top - 1 - __MACRO__DEPTH__] = __MACRO__A__;                                       \
+        lvm_Machine_Stack_Push((MACHINE_P), __MACRO__B__);                                                                      \
+        lvm_machine_advance((MACHINE_P));                                                                                       \
+    } while (0)
+
+#define lvm_Inst_Kind_UNARY(MACHINE_P, INST, A, B, C) \
+    do {                                              \
+        lvm_Unary_Inst((MACHINE_P), A, B, C);         \
+        lvm_machine_advance((MACHINE_P));             \
+    } while (0)
+
+#define lvm_Inst_Kind_BINARY(MACHINE_P, INST, A, B, C) \
+    do {                                               \
+        lvm_Binary_Inst((MACHINE_P), A, B, C);         \
+        lvm_machine_advance((MACHINE_P));              \
+    } while (0)
+
+#define lvm_Inst_Kind_BINARY_FN(MACHINE_P, INST, A, B, C) \
+    do {                                                  \
+        lvm_Binary_Fn_Inst((MACHINE_P), A, B, C);         \
+        lvm_machine_advance((MACHINE_P));                 \
+    } while (0)
+
+#define lvm_Inst_Kind_CAST(MACHINE_P, INST, A, B, C) \
+    do {                                             \
+        lvm_Cast_Inst((MACHINE_P), A, B, C);         \
+        lvm_machine_advance((MACHINE_P));            \
     } while (0)
 
-#define lvm_Memory_Write_Inst(MACHINE_P, TYPE)                                                  \
+#define lvm_Inst_Kind_READ(MACHINE_P, INST, A, B, C) \
+    do {                                             \
+        lvm_Memory_Read_Inst((MACHINE_P), A);        \
+        lvm_machine_advance((MACHINE_P));            \
+    } while (0)
+
+#define lvm_Inst_Kind_WRITE(MACHINE_P, INST, A, B, C) \
+    do {                                              \
+        lvm_Memory_Write_Inst((MACHINE_P), A);        \
+        lvm_machine_advance((MACHINE_P));             \
+    } while (0)
+
+// NOTE: Range instructions do a single bounds check for the whole [addr, addr + size) range and then run at host speed
+#define lvm_Inst_Kind_RANGE(MACHINE_P, INST, A, B, C)                                                                                                    \
+    do {                                                                                                                                                 \
+        lvm_Word __MACRO__SIZE__;                                                                                                                        \
+        lvm_Word __MACRO__ADDR__;                                                                                                                        \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__SIZE__);                                                                                            \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__ADDR__);                                                                                            \
+        if (!lvm_memory_in_bounds(__MACRO__ADDR__.as_u64, __MACRO__SIZE__.as_u64)) {                                                                     \
+            return LVM_TRAP_ILLEGAL_MEMORY_ACCESS;                                                                                                       \
+        }                                                                                                                                                \
+        lvm_Word __MACRO__RESULT__ = { .as_u64 = lvm_##A(&(MACHINE_P)->memory[__MACRO__ADDR__.as_u64], __MACRO__SIZE__.as_u64, (INST).operand.as_u64) }; \
+        lvm_Machine_Stack_Push((MACHINE_P), __MACRO__RESULT__);                                                                                          \
+        lvm_machine_advance((MACHINE_P));                                                                                                                \
+    } while (0)
+
+// NOTE: Pushes the offset of the first matching byte from addr, or -1 when it isn't found
+#define lvm_Inst_Kind_FIND(MACHINE_P, INST, A, B, C)                                                                              \
+    do {                                                                                                                          \
+        lvm_Word __MACRO__BYTE__;                                                                                                 \
+        lvm_Word __MACRO__SIZE__;                                                                                                 \
+        lvm_Word __MACRO__ADDR__;                                                                                                 \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__BYTE__);                                                                     \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__SIZE__);                                                                     \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__ADDR__);                                                                     \
+        if (!lvm_memory_in_bounds(__MACRO__ADDR__.as_u64, __MACRO__SIZE__.as_u64)) {                                              \
+            return LVM_TRAP_ILLEGAL_MEMORY_ACCESS;                                                                                \
+        }                                                                                                                         \
+        const uint8_t *__MACRO__BASE__ = &(MACHINE_P)->memory[__MACRO__ADDR__.as_u64];                                            \
+        const uint8_t *__MACRO__FOUND__ = memchr(__MACRO__BASE__, (uint8_t)__MACRO__BYTE__.as_u64, __MACRO__SIZE__.as_u64);       \
+        lvm_Word __MACRO__RESULT__ = { .as_i64 = __MACRO__FOUND__ != NULL ? (int64_t)(__MACRO__FOUND__ - __MACRO__BASE__) : -1 }; \
+        lvm_Machine_Stack_Push((MACHINE_P), __MACRO__RESULT__);                                                                   \
+        lvm_machine_advance((MACHINE_P));                                                                                         \
+    } while (0)
+
+// NOTE: (entry count out_addr out_size -- ), the operand is the step limit of each child (0 = none), see lvm_machine_spawn
+#define lvm_Inst_Kind_SPAWN(MACHINE_P, INST, A, B, C)                                                               \
+    do {                                                                                                            \
+        lvm_Word __MACRO__OUT_SIZE__;                                                                               \
+        lvm_Word __MACRO__OUT_ADDR__;                                                                               \
+        lvm_Word __MACRO__COUNT__;                                                                                  \
+        lvm_Word __MACRO__ENTRY__;                                                                                  \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__OUT_SIZE__);                                                   \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__OUT_ADDR__);                                                   \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__COUNT__);                                                      \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__ENTRY__);                                                      \
+        lvm_Trap __MACRO__TRAP__ = lvm_machine_spawn((MACHINE_P), __MACRO__ENTRY__.as_u64, __MACRO__COUNT__.as_u64, \
+                                                     __MACRO__OUT_ADDR__.as_u64, __MACRO__OUT_SIZE__.as_u64,        \
+                                                     (INST).operand.as_u64);                                        \
+        if (__MACRO__TRAP__ != LVM_TRAP_OK) {                                                                       \
+            return __MACRO__TRAP__;                                                                                 \
+        }                                                                                                           \
+        lvm_machine_advance((MACHINE_P));                                                                           \
+    } while (0)
+
+#define lvm_Inst_Kind_JOIN(MACHINE_P, INST, A, B, C)                    \
+    do {                                                                \
+        lvm_Trap __MACRO__TRAP__ = lvm_machine_join((MACHINE_P), NULL); \
+        if (__MACRO__TRAP__ != LVM_TRAP_OK) {                           \
+            return __MACRO__TRAP__;                                     \
+        }                                                               \
+        lvm_machine_advance((MACHINE_P));                               \
+    } while (0)
+
+#define lvm_Inst_Kind_CALL(MACHINE_P, INST, A, B, C)                    \
+    do {                                                                \
+        lvm_Word __MACRO__ADDR__;                                       \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__ADDR__);           \
+        lvm_Word __MACRO__OLD_IP__ = { .as_u64 = (MACHINE_P)->ip + 1 }; \
+        (MACHINE_P)->ip = __MACRO__ADDR__.as_u64;                       \
+        lvm_Machine_Stack_Push((MACHINE_P), __MACRO__OLD_IP__);         \
+    } while (0)
+
+#define lvm_Inst_Kind_NATIVE(MACHINE_P, INST, A, B, C)                                          \
     do {                                                                                        \
-        lvm_Word __MACRO__VALUE__;                                                              \
-        lvm_Word __MACRO__ADDR__;                                                               \
-        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__VALUE__);                                  \
-        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__ADDR__);                                   \
-        if (__MACRO__ADDR__.as_u64 >= LVM_MEMORY_MAX - sizeof(TYPE)) {                          \
-            return LVM_TRAP_ILLEGAL_MEMORY_ACCESS;                                              \
-        }                                                                                       \
-        *(TYPE*)&((MACHINE_P)->memory[__MACRO__ADDR__.as_u64]) = (TYPE)__MACRO__VALUE__.as_u64; \
-    } while (0);
+        lvm_Word __MACRO__NATIVE__;                                                             \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__NATIVE__);                                 \
+        assert(__MACRO__NATIVE__.as_u64 < LVM_NATIVE_MAX && "ILLEGAL NATIVE CALL");             \
+        lvm_Trap __MACRO__TRAP__ = (MACHINE_P)->natives[__MACRO__NATIVE__.as_u64]((MACHINE_P)); \
+        lvm_machine_advance((MACHINE_P));                                                       \
+        return __MACRO__TRAP__;                                                                 \
+    } while (0)
+
+#define lvm_Inst_Kind_JMP(MACHINE_P, INST, A, B, C)           \
+    do {                                                      \
+        lvm_Word __MACRO__ADDR__;                             \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__ADDR__); \
+        (MACHINE_P)->ip = __MACRO__ADDR__.as_u64;             \
+    } while (0)
+
+#define lvm_Inst_Kind_JMP_IF(MACHINE_P, INST, A, B, C)        \
+    do {                                                      \
+        lvm_Word __MACRO__ADDR__;                             \
+        lvm_Word __MACRO__COND__;                             \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__ADDR__); \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__COND__); \
+        if (C __MACRO__COND__.as_u64) {                       \
+            (MACHINE_P)->ip = __MACRO__ADDR__.as_u64;         \
+        } else {                                              \
+            lvm_machine_advance((MACHINE_P));                 \
+        }                                                     \
+    } while (0)
+
+#define lvm_Inst_Kind_PRINT_DEBUG(MACHINE_P, INST, A, B, C)                                                                                           \
+    do {                                                                                                                                              \
+        lvm_Word __MACRO__A__;                                                                                                                        \
+        lvm_Machine_Stack_Pop((MACHINE_P), &__MACRO__A__);                                                                                            \
+        printf("[WORD]{ .as_i64 = %"PRId64", .as_u64 = %"PRIu64", .as_f64 = %lf }\n", __MACRO__A__.as_i64, __MACRO__A__.as_u64, __MACRO__A__.as_f64); \
+        lvm_machine_advance((MACHINE_P));                                                                                                             \
+    } while (0)
+
+#define X(OPCODE, NAME, POPS, PUSHES, HAS_OPERAND, VARIABLE_EFFECT, KIND, A, B, C)        \
+    static inline lvm_Trap lvm_inst_##OPCODE(lvm_Machine *machine, const lvm_Inst inst) { \
+        (void)machine;                                                                    \
+        (void)inst;                                                                       \
+        lvm_Inst_Kind_##KIND(machine, inst, A, B, C);                                     \
+        return LVM_TRAP_OK;                                                               \
+    }
+LVM_INST_LIST(X)
+#undef X
 
 LVM_API const char *lvm_get_trap_name(lvm_Trap trap) {
     assert((uint32_t)trap < LVM_MAX_TRAPS && "Illegal trap value");
@@ -319,6 +655,12 @@ LVM_API const char *lvm_get_inst_name(lvm_InstType inst) {
     return lvm_insts_names[inst];
 }
 
+LVM_API const lvm_InstInfo *lvm_get_inst_info(lvm_InstType inst) {
+    assert((uint32_t)inst < LVM_MAX_INSTS && "Illegal inst value");
+
+    return &lvm_insts_info[inst];
+}
+
 LVM_API lvm_Program lvm_create_program(const lvm_Inst *const insts, size_t insts_count, const uint8_t *const memory, size_t memory_size) {
     assert(memory_size <= LVM_MEMORY_MAX && "Illegal size of memory for a program");
     assert(insts != NULL && "Illegal pointer(NULL)");
@@ -344,13 +686,38 @@ LVM_API lvm_Machine *lvm_create_machine(void) {
     return machine;
 }
 
+LVM_API void lvm_destroy_machine(lvm_Machine *machine) {
+    assert(machine != NULL && "Illegal pointer(NULL)");
+
+    if (machine->spawn != NULL) {
+        lvm_machine_join(machine, NULL);
+    }
+
+    if (machine->cached != NULL) {
+        lvm_program_cache_release(machine->cached);
+    }
+
+    free(machine);
+}
+
 LVM_API void lvm_machine_load_program(lvm_Machine *machine, lvm_Program program) {
     assert(machine != NULL && "Illegal pointer(NULL)");
     
+    // NOTE: Children left running by the previous program are waited for and their results dropped
+    if (machine->spawn != NULL) {
+        lvm_machine_join(machine, NULL);
+    }
+
+    if (machine->cached != NULL) {
+        lvm_program_cache_release(machine->cached);
+        machine->cached = NULL;
+    }
+
     machine->program = program;
     machine->hlt = false;
     machine->ip = 0;
     machine->stack_top = 0;
+    machine->spawned_insts = 0;
 
     if (program.memory != NULL && program.memory_size != 0) {
         assert(program.memory_size <= LVM_MEMORY_MAX && "Illegal size of memory for a program");
@@ -358,6 +725,16 @@ LVM_API void lvm_machine_load_program(lvm_Machine *machine, lvm_Program program)
     }
 }
 
+LVM_API void lvm_machine_load_cached_program(lvm_Machine *machine, lvm_CachedProgram *cached) {
+    assert(machine != NULL && "Illegal pointer(NULL)");
+    assert(cached != NULL && "Illegal pointer(NULL)");
+
+    // NOTE: Retained before loading in case the machine already holds the last reference to it
+    lvm_program_cache_retain(cached);
+    lvm_machine_load_program(machine, lvm_cached_program_get(cached));
+    machine->cached = cached;
+}
+
 void lvm_dump_stack(const lvm_Machine *const lvm, FILE *stream) {
     fprintf(stream, "-----------------------------------------\n");
     fprintf(stream, "Stack:\n");
@@ -374,26 +751,37 @@ void lvm_dump_stack(const lvm_Machine *const lvm, FILE *stream) {
     fprintf(stream, "-----------------------------------------\n");
 }
 
-LVM_API lvm_Trap lvm_machine_run(lvm_Machine *machine, int64_t limit) {
-    assert(machine != NULL && "Illegal pointer(NULL)");
-    
+static lvm_Trap lvm_machine_run_counted(lvm_Machine *machine, int64_t limit, uint64_t *executed) {
+    uint64_t count = 0;
+    lvm_Trap trap = LVM_TRAP_OK;
+
     for (; limit != 0 && !machine->hlt; ) {
-        lvm_Trap trap = lvm_machine_execute_inst(machine);
+        trap = lvm_machine_execute_inst(machine);
 
         if (trap != LVM_TRAP_OK) {
-            return trap;
+            break;
         }
 
+        count++;
+
         if (limit > 0) {
             limit--;
         }
     }
 
-    return LVM_TRAP_OK;
+    if (executed != NULL) {
+        *executed = count;
+    }
+
+    return trap;
+}
+
+LVM_API lvm_Trap lvm_machine_run(lvm_Machine *machine, int64_t limit) {
+    assert(machine != NULL && "Illegal pointer(NULL)");
+    
+    return lvm_machine_run_counted(machine, limit, NULL);
 }
 
-// TODO: FIX STATIC ASSERT
-// static_assert (LVM_MAX_INSTS == 65, "THE INSTRUCTION SET CHANGED PLEASE UPDATE THE CODE");
 LVM_API lvm_Trap lvm_machine_execute_inst(lvm_Machine *machine) {
     assert(machine != NULL && "Illegal pointer(NULL)");
 
@@ -404,368 +792,943 @@ LVM_API lvm_Trap lvm_machine_execute_inst(lvm_Machine *machine) {
     lvm_Inst inst = program.insts[machine->ip];
     
     switch (inst.type) {
-        case LVM_INST_NOP: {
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_PUSH: {
-            lvm_Machine_Stack_Push(machine, inst.operand);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_POP: {
-            lvm_Machine_Stack_Pop(machine, NULL);
-            lvm_machine_advance(machine);
+#define X(OPCODE, ...) case LVM_INST_##OPCODE: return lvm_inst_##OPCODE(machine, inst);
+        LVM_INST_LIST(X)
+#undef X
+        case LVM_MAX_INSTS:
+        default: {
+            return LVM_TRAP_ILLEGAL_INST;
         } break;
-        case LVM_INST_DUP: {
-            lvm_Word a;
+    }
+}
 
-            lvm_Machine_Stack_Pop(machine, &a);
+LVM_API lvm_Trap lvm_machine_stack_push(lvm_Machine *machine, lvm_Word word) {
+    assert(machine != NULL && "Illegal pointer(NULL)");
+    
+    if (machine->stack_top >= LVM_STACK_MAX) {
+        return LVM_TRAP_STACK_OVERFLOW;
+    }
 
-            lvm_Machine_Stack_Push(machine, a);
-            lvm_Machine_Stack_Push(machine, a);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_SWAP: {
-            if (machine->stack_top < 2 || (uint64_t)(machine->stack_top - 2 - inst.operand.as_u64) > machine->stack_top) {
-                return LVM_TRAP_STACK_UNDERFLOW;
-            }
+    machine->stack[machine->stack_top++] = word;
 
-            lvm_Word a;
-            lvm_Word b;
+    return LVM_TRAP_OK;
+}
 
-            lvm_Machine_Stack_Pop(machine, &a);
-            b = machine->stack[machine->stack_top - 1 - inst.operand.as_u64];
+LVM_API lvm_Trap lvm_machine_stack_pop(lvm_Machine *machine, lvm_Word *word) {
+    assert(machine != NULL && "Illegal pointer(NULL)");
+    
+    if (machine->stack_top < 1) {
+        return LVM_TRAP_STACK_UNDERFLOW;
+    }
 
-            machine->stack[machine->stack_top - 1 - inst.operand.as_u64] = a;
-            lvm_Machine_Stack_Push(machine, b);
-            
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_INCI: {
-            lvm_Unary_Inst(machine, i64, i64, ++);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_INCF: {
-            lvm_Unary_Inst(machine, f64, f64, ++);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_DECI: {
-            lvm_Unary_Inst(machine, i64, i64, --);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_DECF: {
-            lvm_Unary_Inst(machine, f64, f64, --);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_ADDI: {
-            lvm_Binary_Inst(machine, i64, i64, +);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_ADDF: {
-            lvm_Binary_Inst(machine, f64, f64, +);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_SUBI: {
-            lvm_Binary_Inst(machine, i64, i64, -);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_SUBF: {
-            lvm_Binary_Inst(machine, f64, f64, -);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_MULTI: {
-            lvm_Binary_Inst(machine, i64, i64, *);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_MULTF: {
-            lvm_Binary_Inst(machine, f64, f64, *);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_DIVI: {
-            lvm_Binary_Inst(machine, i64, i64, /);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_DIVU: {
-            lvm_Binary_Inst(machine, u64, u64, /);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_DIVF: {
-            lvm_Binary_Inst(machine, f64, f64, /);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_MODI: {
-            lvm_Binary_Inst(machine, i64, i64, %);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_MODU: {
-            lvm_Binary_Inst(machine, u64, u64, %);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_MODF: {
-            lvm_Word a;
-            lvm_Word b;
+    machine->stack_top--;
 
-            lvm_Machine_Stack_Pop(machine, &a);
-            lvm_Machine_Stack_Pop(machine, &b);
+    if (word != NULL) {
+        *word = machine->stack[machine->stack_top];
+    }
 
-            lvm_Word result = { .as_f64 = fmod(a.as_f64, b.as_f64) };
+    return LVM_TRAP_OK;
+}
 
-            lvm_Machine_Stack_Push(machine, result);
+LVM_API void lvm_machine_advance(lvm_Machine *machine) {
+    assert(machine != NULL && "Illegal pointer(NULL)");
 
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_EQ: {
-            lvm_Binary_Inst(machine, u64, u64, ==);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_NEQ: {
-            lvm_Binary_Inst(machine, u64, u64, !=);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_GTI: {
-            lvm_Binary_Inst(machine, u64, i64, >);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_GTU: {
-            lvm_Binary_Inst(machine, u64, u64, >);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_GTF: {
-            lvm_Binary_Inst(machine, u64, f64, >);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_GEI: {
-            lvm_Binary_Inst(machine, u64, i64, >=);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_GEU: {
-            lvm_Binary_Inst(machine, u64, u64, >=);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_GEF: {
-            lvm_Binary_Inst(machine, u64, f64, >=);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_STI: {
-            lvm_Binary_Inst(machine, u64, i64, <);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_STU: {
-            lvm_Binary_Inst(machine, u64, u64, <);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_STF: {
-            lvm_Binary_Inst(machine, u64, f64, <);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_SEI: {
-            lvm_Binary_Inst(machine, u64, i64, <=);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_SEU: {
-            lvm_Binary_Inst(machine, u64, u64, <=);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_SEF: {
-            lvm_Binary_Inst(machine, u64, f64, <=);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_AND: {
-            lvm_Binary_Inst(machine, u64, u64, &&);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_NOT: {
-            lvm_Unary_Inst(machine, u64, u64, !);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_OR: {
-            lvm_Binary_Inst(machine, u64, u64, ||);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_ANDB: {
-            lvm_Binary_Inst(machine, u64, u64, &);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_NOTB: {
-            lvm_Unary_Inst(machine, u64, u64, ~);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_ORB: {
-            lvm_Binary_Inst(machine, u64, u64, |);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_XOR: {
-            lvm_Binary_Inst(machine, u64, u64, ^);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_SHL: {
-            lvm_Binary_Inst(machine, u64, u64, <<);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_SHR: {
-            lvm_Binary_Inst(machine, u64, u64, >>);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_CALL: {
-            lvm_Word addr;
+    machine->ip++;
+}
 
-            lvm_Machine_Stack_Pop(machine, &addr);
+typedef struct lvm_SpawnTask lvm_SpawnTask;
 
-            lvm_Word old_ip = { .as_u64 = machine->ip + 1 };
+struct lvm_SpawnTask {
+    uint64_t index;
+    lvm_Trap trap;
+    uint64_t insts;
+    lvm_SpawnGroup *group;
+};
 
-            machine->ip = addr.as_u64;
+// NOTE: Everything a child is created from, taken from the parent when it spawns. The group holds
+//       the reference to the cached program for all of its children.
+struct lvm_SpawnGroup {
+    size_t pending;
+    size_t claimed;
+    lvm_SpawnGroup *queue_next;
+    lvm_OpAddr entry;
+    lvm_MemAddr out_addr;
+    uint64_t out_size;
+    int64_t limit;
+    uint8_t *out;
 
-            lvm_Machine_Stack_Push(machine, old_ip);
-        } break;
-        case LVM_INST_NATIVE: {
-            lvm_Word native;
+    lvm_Program program;
+    lvm_CachedProgram *cached;
+    lvm_Native natives[LVM_NATIVE_MAX];
+    size_t natives_top;
+    uint8_t memory[LVM_MEMORY_MAX];
 
-            lvm_Machine_Stack_Pop(machine, &native);
+    size_t count;
+    lvm_SpawnTask tasks[];
+};
 
-            assert(native.as_u64 < LVM_NATIVE_MAX && "ILLEGAL NATIVE CALL");
+// NOTE: The pool is shared by every machine of the process and queues groups, a group leaves the queue
+//       once all of its children have been claimed. A thread waiting in lvm_machine_join claims the
+//       children of its own group instead of sleeping, so nested spawns can't deadlock the pool, and
+//       it never ends up running the children of an unrelated machine.
+static struct {
+    lvm_Mutex lock;
+    lvm_Cond cond;
+    lvm_SpawnGroup *head;
+    lvm_SpawnGroup *tail;
+    bool started;
+} lvm_spawn_pool = { .lock = LVM_MUTEX_INIT, .cond = LVM_COND_INIT };
+
+// NOTE: Must be called with the pool lock held and a child of GROUP left to claim
+static lvm_SpawnTask *lvm_spawn_pool_claim(lvm_SpawnGroup *group) {
+    lvm_SpawnTask *task = &group->tasks[group->claimed++];
+
+    if (group->claimed == group->count) {
+        lvm_SpawnGroup *prev = NULL;
+        lvm_SpawnGroup *it = lvm_spawn_pool.head;
+
+        while (it != group) {
+            prev = it;
+            it = it->queue_next;
+        }
 
-            lvm_Trap trap = machine->natives[native.as_u64](machine);
-            lvm_machine_advance(machine);
+        if (prev != NULL) {
+            prev->queue_next = group->queue_next;
+        } else {
+            lvm_spawn_pool.head = group->queue_next;
+        }
 
-            return trap;
-        } break;
-        case LVM_INST_RETURN: {
-            lvm_Word addr;
+        if (lvm_spawn_pool.tail == group) {
+            lvm_spawn_pool.tail = prev;
+        }
 
-            lvm_Machine_Stack_Pop(machine, &addr);
+        group->queue_next = NULL;
+    }
 
-            machine->ip = addr.as_u64;
-        } break;
-        case LVM_INST_JMP: {
-            lvm_Word addr;
+    return task;
+}
 
-            lvm_Machine_Stack_Pop(machine, &addr);
+// NOTE: Called with the pool lock held, releases it while the task's machine runs. The child only
+//       exists while it runs: its output region is copied into the group before it's destroyed.
+static void lvm_spawn_pool_run(lvm_SpawnTask *task) {
+    lvm_mutex_unlock(&lvm_spawn_pool.lock);
 
-            machine->ip = addr.as_u64;
-        } break;
-        case LVM_INST_JZ: {
-            lvm_Word addr;
-            lvm_Word cond;
+    lvm_SpawnGroup *group = task->group;
+    lvm_Machine *child = malloc(sizeof(*child));
 
-            lvm_Machine_Stack_Pop(machine, &addr);
-            lvm_Machine_Stack_Pop(machine, &cond);
+    assert(child != NULL && "Illegal pointer(NULL)");
 
-            if (!cond.as_u64) {
-                machine->ip = addr.as_u64;
-            } else {
-                lvm_machine_advance(machine);
-            }
-        } break;
-        case LVM_INST_JNZ: {
-            lvm_Word addr;
-            lvm_Word cond;
+    memcpy(child->memory, group->memory, sizeof(child->memory));
+    memcpy(child->natives, group->natives, sizeof(child->natives));
+    child->natives_top = group->natives_top;
+    child->program = group->program;
+    child->cached = NULL;
+    child->stack[0] = (lvm_Word){ .as_u64 = task->index };
+    child->stack_top = 1;
+    child->ip = group->entry;
+    child->hlt = false;
+    child->spawn = NULL;
+    child->spawned_insts = 0;
 
-            lvm_Machine_Stack_Pop(machine, &addr);
-            lvm_Machine_Stack_Pop(machine, &cond);
+    task->trap = lvm_machine_run_counted(child, group->limit, &task->insts);
 
-            if (cond.as_u64) {
-                machine->ip = addr.as_u64;
-            } else {
-                lvm_machine_advance(machine);
-            }
-        } break;
-        case LVM_INST_I2F: {
-            lvm_Cast_Inst(machine, i64, f64, (double));
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_U2F: {
-            lvm_Cast_Inst(machine, u64, f64, (double));
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_F2I: {
-            lvm_Cast_Inst(machine, f64, i64, (int64_t));
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_F2U: {
-            lvm_Cast_Inst(machine, f64, u64, (uint64_t)(int64_t));
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_READ8: {
-            lvm_Memory_Read_Inst(machine, uint8_t);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_READ16: {
-            lvm_Memory_Read_Inst(machine, uint16_t);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_READ32: {
-            lvm_Memory_Read_Inst(machine, uint32_t);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_READ64: {
-            lvm_Memory_Read_Inst(machine, uint64_t);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_WRITE8: {
-            lvm_Memory_Write_Inst(machine, uint8_t);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_WRITE16: {
-            lvm_Memory_Write_Inst(machine, uint16_t);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_WRITE32: {
-            lvm_Memory_Write_Inst(machine, uint32_t);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_WRITE64: {
-            lvm_Memory_Write_Inst(machine, uint64_t);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_HLT: {
-            machine->hlt = true;
-        } break;
-        case LVM_INST_PRINT_DEBUG: {
-            lvm_Word a;
+    if (task->trap == LVM_TRAP_OK && !child->hlt) {
+        task->trap = LVM_TRAP_SPAWN_LIMIT;
+    }
 
-            lvm_Machine_Stack_Pop(machine, &a);
-            printf("[WORD]{ .as_i64 = %"PRId64", .as_u64 = %"PRIu64", .as_f64 = %lf }\n", a.as_i64, a.as_u64, a.as_f64);
-            lvm_machine_advance(machine);
-        } break;
-        case LVM_INST_ILLEGAL:
-        case LVM_MAX_INSTS:
-        default: {
-            return LVM_TRAP_ILLEGAL_INST;
-        } break;
+    // NOTE: Children the child left running are waited for here so their instructions are counted too
+    if (child->spawn != NULL) {
+        lvm_machine_join(child, NULL);
     }
 
-    return LVM_TRAP_OK;
-}
+    task->insts += child->spawned_insts;
 
-LVM_API lvm_Trap lvm_machine_stack_push(lvm_Machine *machine, lvm_Word word) {
-    assert(machine != NULL && "Illegal pointer(NULL)");
-    
-    if (machine->stack_top >= LVM_STACK_MAX) {
-        return LVM_TRAP_STACK_OVERFLOW;
+    if (task->trap == LVM_TRAP_OK && group->out_size != 0) {
+        uint64_t offset = task->index * group->out_size;
+        memcpy(&group->out[offset], &child->memory[group->out_addr + offset], group->out_size);
     }
 
-    machine->stack[machine->stack_top++] = word;
+    lvm_destroy_machine(child);
 
-    return LVM_TRAP_OK;
+    lvm_mutex_lock(&lvm_spawn_pool.lock);
+
+    if (--task->group->pending == 0) {
+        lvm_cond_broadcast(&lvm_spawn_pool.cond);
+    }
 }
 
-LVM_API lvm_Trap lvm_machine_stack_pop(lvm_Machine *machine, lvm_Word *word) {
-    assert(machine != NULL && "Illegal pointer(NULL)");
-    
-    if (machine->stack_top < 1) {
-        return LVM_TRAP_STACK_UNDERFLOW;
+static LVM_THREAD_FN(lvm_spawn_pool_worker) {
+    (void)arg;
+
+    lvm_mutex_lock(&lvm_spawn_pool.lock);
+
+    for (;;) {
+        if (lvm_spawn_pool.head == NULL) {
+            lvm_cond_wait(&lvm_spawn_pool.cond, &lvm_spawn_pool.lock);
+            continue;
+        }
+
+        lvm_spawn_pool_run(lvm_spawn_pool_claim(lvm_spawn_pool.head));
     }
 
-    if (word != NULL) {
-        *word = machine->stack[--machine->stack_top];
+    return 0;
+}
+
+// NOTE: Must be called with the pool lock held
+static void lvm_spawn_pool_start(void) {
+    size_t workers = LVM_SPAWN_WORKERS != 0 ? LVM_SPAWN_WORKERS : lvm_hardware_threads();
+
+    for (size_t i = 0; i < workers; i++) {
+        lvm_thread_start(lvm_spawn_pool_worker);
     }
 
-    return LVM_TRAP_OK;
+    lvm_spawn_pool.started = true;
 }
 
-LVM_API void lvm_machine_advance(lvm_Machine *machine) {
+// NOTE: Starts COUNT children at ENTRY, child i starts with i on its stack. Every child shares the
+//       parent's program and natives (the whole table, hosts fill it directly) and runs on a snapshot
+//       of the parent's memory, so the parent's memory is read-only for it. Child i owns [out_addr + i * out_size, out_addr + (i + 1) * out_size),
+//       which lvm_machine_join copies back into the parent, every other write of a child is dropped.
+//       A child that hasn't halted after LIMIT instructions (0 means no limit) fails with LVM_TRAP_SPAWN_LIMIT.
+//       Cost: the spawn itself takes one snapshot of the parent's memory plus the output regions
+//       (about LVM_MEMORY_MAX + count * out_size bytes) and the children are only created when a thread
+//       starts running them, so only one lvm_Machine (~656 KB) per busy thread and nesting level exists
+//       at a time, however large COUNT is. Every child still pays a copy of the snapshot when it starts.
+LVM_API lvm_Trap lvm_machine_spawn(lvm_Machine *machine, lvm_OpAddr entry, uint64_t count, lvm_MemAddr out_addr, uint64_t out_size, uint64_t limit) {
     assert(machine != NULL && "Illegal pointer(NULL)");
 
-    machine->ip++;
+    if (machine->spawn != NULL || count == 0 || count > LVM_SPAWN_MAX) {
+        return LVM_TRAP_ILLEGAL_SPAWN;
+    }
+
+    if (out_size > LVM_MEMORY_MAX / count || !lvm_memory_in_bounds(out_addr, out_size * count)) {
+        return LVM_TRAP_ILLEGAL_MEMORY_ACCESS;
+    }
+
+    lvm_SpawnGroup *group = malloc(sizeof(*group) + count * sizeof(group->tasks[0]));
+
+    assert(group != NULL && "Illegal pointer(NULL)");
+
+    group->pending = count;
+    group->claimed = 0;
+    group->queue_next = NULL;
+    group->entry = entry;
+    group->out_addr = out_addr;
+    group->out_size = out_size;
+    group->limit = limit != 0 && limit <= INT64_MAX ? (int64_t)limit : -1;
+    group->out = NULL;
+
+    if (out_size != 0) {
+        group->out = malloc(out_size * count);
+
+        assert(group->out != NULL && "Illegal pointer(NULL)");
+    }
+
+    group->program = machine->program;
+    group->cached = machine->cached != NULL ? lvm_program_cache_retain(machine->cached) : NULL;
+    memcpy(group->natives, machine->natives, sizeof(group->natives));
+    group->natives_top = machine->natives_top;
+    memcpy(group->memory, machine->memory, sizeof(group->memory));
+    group->count = count;
+
+    for (uint64_t i = 0; i < count; i++) {
+        group->tasks[i] = (lvm_SpawnTask){ .index = i, .trap = LVM_TRAP_OK, .insts = 0, .group = group };
+    }
+
+    lvm_mutex_lock(&lvm_spawn_pool.lock);
+
+    if (!lvm_spawn_pool.started) {
+        lvm_spawn_pool_start();
+    }
+
+    if (lvm_spawn_pool.tail != NULL) {
+        lvm_spawn_pool.tail->queue_next = group;
+    } else {
+        lvm_spawn_pool.head = group;
+    }
+
+    lvm_spawn_pool.tail = group;
+
+    lvm_cond_broadcast(&lvm_spawn_pool.cond);
+    lvm_mutex_unlock(&lvm_spawn_pool.lock);
+
+    machine->spawn = group;
+
+    return LVM_TRAP_OK;
+}
+
+// NOTE: Waits for every child of the last spawn and copies their output regions back into the parent.
+//       Returns the trap of the first child that failed, in which case nothing is copied back.
+//       The instructions run by the children are added to machine->spawned_insts and stored in INSTS if not NULL.
+LVM_API lvm_Trap lvm_machine_join(lvm_Machine *machine, uint64_t *insts) {
+    assert(machine != NULL && "Illegal pointer(NULL)");
+
+    lvm_SpawnGroup *group = machine->spawn;
+
+    if (group == NULL) {
+        return LVM_TRAP_ILLEGAL_SPAWN;
+    }
+
+    lvm_mutex_lock(&lvm_spawn_pool.lock);
+
+    while (group->pending > 0) {
+        if (group->claimed < group->count) {
+            lvm_spawn_pool_run(lvm_spawn_pool_claim(group));
+        } else {
+            lvm_cond_wait(&lvm_spawn_pool.cond, &lvm_spawn_pool.lock);
+        }
+    }
+
+    lvm_mutex_unlock(&lvm_spawn_pool.lock);
+
+    lvm_Trap trap = LVM_TRAP_OK;
+    uint64_t total = 0;
+
+    for (size_t i = 0; i < group->count; i++) {
+        if (trap == LVM_TRAP_OK) {
+            trap = group->tasks[i].trap;
+        }
+
+        total += group->tasks[i].insts;
+    }
+
+    machine->spawned_insts += total;
+
+    if (insts != NULL) {
+        *insts = total;
+    }
+
+    if (trap == LVM_TRAP_OK && group->out_size != 0) {
+        memcpy(&machine->memory[group->out_addr], group->out, group->out_size * group->count);
+    }
+
+    if (group->cached != NULL) {
+        lvm_program_cache_release(group->cached);
+    }
+
+    free(group->out);
+    free(group);
+    machine->spawn = NULL;
+
+    return trap;
+}
+
+// NOTE: CRC32C (Castagnoli). On x86-64 GCC/Clang builds the SSE4.2 crc32 instruction is picked at runtime
+//       when the CPU has it, on ARMv8 the crc32 instructions are used when the target enables them
+//       (-march=armv8-a+crc...), everything else falls back to a byte-wise table
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define LVM_CRC32C_SSE42
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#define LVM_CRC32C_ARM
+#include <arm_acle.h>
+#endif
+
+#ifndef LVM_CRC32C_ARM
+static const uint32_t lvm_crc32c_table[256] = {
+    0x00000000, 0xF26B8303, 0xE13B70F7, 0x1350F3F4, 0xC79A971F, 0x35F1141C, 0x26A1E7E8, 0xD4CA64EB,
+    0x8AD958CF, 0x78B2DBCC, 0x6BE22838, 0x9989AB3B, 0x4D43CFD0, 0xBF284CD3, 0xAC78BF27, 0x5E133C24,
+    0x105EC76F, 0xE235446C, 0xF165B798, 0x030E349B, 0xD7C45070, 0x25AFD373, 0x36FF2087, 0xC494A384,
+    0x9A879FA0, 0x68EC1CA3, 0x7BBCEF57, 0x89D76C54, 0x5D1D08BF, 0xAF768BBC, 0xBC267848, 0x4E4DFB4B,
+    0x20BD8EDE, 0xD2D60DDD, 0xC186FE29, 0x33ED7D2A, 0xE72719C1, 0x154C9AC2, 0x061C6936, 0xF477EA35,
+    0xAA64D611, 0x580F5512, 0x4B5FA6E6, 0xB93425E5, 0x6DFE410E, 0x9F95C20D, 0x8CC531F9, 0x7EAEB2FA,
+    0x30E349B1, 0xC288CAB2, 0xD1D83946, 0x23B3BA45, 0xF779DEAE, 0x05125DAD, 0x1642AE59, 0xE4292D5A,
+    0xBA3A117E, 0x4851927D, 0x5B016189, 0xA96AE28A, 0x7DA08661, 0x8FCB0562, 0x9C9BF696, 0x6EF07595,
+    0x417B1DBC, 0xB3109EBF, 0xA0406D4B, 0x522BEE48, 0x86E18AA3, 0x748A09A0, 0x67DAFA54, 0x95B17957,
+    0xCBA24573, 0x39C9C670, 0x2A993584, 0xD8F2B687, 0x0C38D26C, 0xFE53516F, 0xED03A29B, 0x1F682198,
+    0x5125DAD3, 0xA34E59D0, 0xB01EAA24, 0x42752927, 0x96BF4DCC, 0x64D4CECF, 0x77843D3B, 0x85EFBE38,
+    0xDBFC821C, 0x2997011F, 0x3AC7F2EB, 0xC8AC71E8, 0x1C661503, 0xEE0D9600, 0xFD5D65F4, 0x0F36E6F7,
+    0x61C69362, 0x93AD1061, 0x80FDE395, 0x72966096, 0xA65C047D, 0x5437877E, 0x4767748A, 0xB50CF789,
+    0xEB1FCBAD, 0x197448AE, 0x0A24BB5A, 0xF84F3859, 0x2C855CB2, 0xDEEEDFB1, 0xCDBE2C45, 0x3FD5AF46,
+    0x7198540D, 0x83F3D70E, 0x90A324FA, 0x62C8A7F9, 0xB602C312, 0x44694011, 0x5739B3E5, 0xA55230E6,
+    0xFB410CC2, 0x092A8FC1, 0x1A7A7C35, 0xE811FF36, 0x3CDB9BDD, 0xCEB018DE, 0xDDE0EB2A, 0x2F8B6829,
+    0x82F63B78, 0x709DB87B, 0x63CD4B8F, 0x91A6C88C, 0x456CAC67, 0xB7072F64, 0xA457DC90, 0x563C5F93,
+    0x082F63B7, 0xFA44E0B4, 0xE9141340, 0x1B7F9043, 0xCFB5F4A8, 0x3DDE77AB, 0x2E8E845F, 0xDCE5075C,
+    0x92A8FC17, 0x60C37F14, 0x73938CE0, 0x81F80FE3, 0x55326B08, 0xA759E80B, 0xB4091BFF, 0x466298FC,
+    0x1871A4D8, 0xEA1A27DB, 0xF94AD42F, 0x0B21572C, 0xDFEB33C7, 0x2D80B0C4, 0x3ED04330, 0xCCBBC033,
+    0xA24BB5A6, 0x502036A5, 0x4370C551, 0xB11B4652, 0x65D122B9, 0x97BAA1BA, 0x84EA524E, 0x7681D14D,
+    0x2892ED69, 0xDAF96E6A, 0xC9A99D9E, 0x3BC21E9D, 0xEF087A76, 0x1D63F975, 0x0E330A81, 0xFC588982,
+    0xB21572C9, 0x407EF1CA, 0x532E023E, 0xA145813D, 0x758FE5D6, 0x87E466D5, 0x94B49521, 0x66DF1622,
+    0x38CC2A06, 0xCAA7A905, 0xD9F75AF1, 0x2B9CD9F2, 0xFF56BD19, 0x0D3D3E1A, 0x1E6DCDEE, 0xEC064EED,
+    0xC38D26C4, 0x31E6A5C7, 0x22B65633, 0xD0DDD530, 0x0417B1DB, 0xF67C32D8, 0xE52CC12C, 0x1747422F,
+    0x49547E0B, 0xBB3FFD08, 0xA86F0EFC, 0x5A048DFF, 0x8ECEE914, 0x7CA56A17, 0x6FF599E3, 0x9D9E1AE0,
+    0xD3D3E1AB, 0x21B862A8, 0x32E8915C, 0xC083125F, 0x144976B4, 0xE622F5B7, 0xF5720643, 0x07198540,
+    0x590AB964, 0xAB613A67, 0xB831C993, 0x4A5A4A90, 0x9E902E7B, 0x6CFBAD78, 0x7FAB5E8C, 0x8DC0DD8F,
+    0xE330A81A, 0x115B2B19, 0x020BD8ED, 0xF0605BEE, 0x24AA3F05, 0xD6C1BC06, 0xC5914FF2, 0x37FACCF1,
+    0x69E9F0D5, 0x9B8273D6, 0x88D28022, 0x7AB90321, 0xAE7367CA, 0x5C18E4C9, 0x4F48173D, 0xBD23943E,
+    0xF36E6F75, 0x0105EC76, 0x12551F82, 0xE03E9C81, 0x34F4F86A, 0xC69F7B69, 0xD5CF889D, 0x27A40B9E,
+    0x79B737BA, 0x8BDCB4B9, 0x988C474D, 0x6AE7C44E, 0xBE2DA0A5, 0x4C4623A6, 0x5F16D052, 0xAD7D5351,
+};
+
+static uint32_t lvm_crc32c_table_update(uint32_t crc, const uint8_t *data, size_t size) {
+    for (; size > 0; data++, size--) {
+        crc = lvm_crc32c_table[(crc ^ *data) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+#endif
+
+#ifdef LVM_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t lvm_crc32c_sse42_update(uint32_t crc, const uint8_t *data, size_t size) {
+    uint64_t crc64 = crc;
+
+    for (; size >= 8; data += 8, size -= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, data, 8);
+        crc64 = _mm_crc32_u64(crc64, chunk);
+    }
+
+    crc = (uint32_t)crc64;
+
+    for (; size > 0; data++, size--) {
+        crc = _mm_crc32_u8(crc, *data);
+    }
+
+    return crc;
+}
+#endif
+
+#ifdef LVM_CRC32C_ARM
+static uint32_t lvm_crc32c_arm_update(uint32_t crc, const uint8_t *data, size_t size) {
+    for (; size >= 8; data += 8, size -= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, data, 8);
+        crc = __crc32cd(crc, chunk);
+    }
+
+    for (; size > 0; data++, size--) {
+        crc = __crc32cb(crc, *data);
+    }
+
+    return crc;
+}
+#endif
+
+LVM_API uint32_t lvm_crc32c(const uint8_t *data, size_t size, uint32_t crc) {
+    assert(!(data == NULL && size != 0) && "Illegal pointer(NULL)");
+
+#if defined(LVM_CRC32C_SSE42)
+    if (__builtin_cpu_supports("sse4.2")) {
+        return ~lvm_crc32c_sse42_update(~crc, data, size);
+    }
+
+    return ~lvm_crc32c_table_update(~crc, data, size);
+#elif defined(LVM_CRC32C_ARM)
+    return ~lvm_crc32c_arm_update(~crc, data, size);
+#else
+    return ~lvm_crc32c_table_update(~crc, data, size);
+#endif
+}
+
+// NOTE: lvm_hash64 is XXH64. Words are always read little-endian, so a hash is the same on every host
+#define LVM_XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define LVM_XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define LVM_XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define LVM_XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define LVM_XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t lvm_rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// NOTE: Compilers turn these into a single load on little-endian hosts
+static inline uint32_t lvm_read_le32(const uint8_t *data) {
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static inline uint64_t lvm_read_le64(const uint8_t *data) {
+    return (uint64_t)lvm_read_le32(data) | ((uint64_t)lvm_read_le32(data + 4) << 32);
+}
+
+static inline uint64_t lvm_xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * LVM_XXH_PRIME64_2;
+    acc = lvm_rotl64(acc, 31);
+    return acc * LVM_XXH_PRIME64_1;
+}
+
+static inline uint64_t lvm_xxh64_merge_round(uint64_t acc, uint64_t value) {
+    acc ^= lvm_xxh64_round(0, value);
+    return acc * LVM_XXH_PRIME64_1 + LVM_XXH_PRIME64_4;
+}
+
+LVM_API uint64_t lvm_hash64(const uint8_t *data, size_t size, uint64_t seed) {
+    assert(!(data == NULL && size != 0) && "Illegal pointer(NULL)");
+
+    const uint8_t *end = data + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + LVM_XXH_PRIME64_1 + LVM_XXH_PRIME64_2;
+        uint64_t v2 = seed + LVM_XXH_PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - LVM_XXH_PRIME64_1;
+
+        for (; end - data >= 32; data += 32) {
+            v1 = lvm_xxh64_round(v1, lvm_read_le64(data));
+            v2 = lvm_xxh64_round(v2, lvm_read_le64(data + 8));
+            v3 = lvm_xxh64_round(v3, lvm_read_le64(data + 16));
+            v4 = lvm_xxh64_round(v4, lvm_read_le64(data + 24));
+        }
+
+        hash = lvm_rotl64(v1, 1) + lvm_rotl64(v2, 7) + lvm_rotl64(v3, 12) + lvm_rotl64(v4, 18);
+        hash = lvm_xxh64_merge_round(hash, v1);
+        hash = lvm_xxh64_merge_round(hash, v2);
+        hash = lvm_xxh64_merge_round(hash, v3);
+        hash = lvm_xxh64_merge_round(hash, v4);
+    } else {
+        hash = seed + LVM_XXH_PRIME64_5;
+    }
+
+    hash += (uint64_t)size;
+
+    for (; end - data >= 8; data += 8) {
+        hash ^= lvm_xxh64_round(0, lvm_read_le64(data));
+        hash = lvm_rotl64(hash, 27) * LVM_XXH_PRIME64_1 + LVM_XXH_PRIME64_4;
+    }
+
+    if (end - data >= 4) {
+        hash ^= (uint64_t)lvm_read_le32(data) * LVM_XXH_PRIME64_1;
+        hash = lvm_rotl64(hash, 23) * LVM_XXH_PRIME64_2 + LVM_XXH_PRIME64_3;
+        data += 4;
+    }
+
+    for (; data < end; data++) {
+        hash ^= (uint64_t)*data * LVM_XXH_PRIME64_5;
+        hash = lvm_rotl64(hash, 11) * LVM_XXH_PRIME64_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= LVM_XXH_PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= LVM_XXH_PRIME64_3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+struct lvm_CachedProgram {
+    atomic_size_t refs;
+    uint64_t hash;
+    size_t size;
+    bool cached;
+
+    lvm_Program program;
+
+    lvm_CachedProgram *bucket_next;
+    lvm_CachedProgram *lru_prev;
+    lvm_CachedProgram *lru_next;
+};
+
+// NOTE: The cache holds one reference to every entry it contains. Lookups, inserts and evictions
+//       are done under the lock, retain and release only touch the atomic reference count.
+static struct {
+    lvm_Mutex lock;
+    lvm_CachedProgram *buckets[LVM_PROGRAM_CACHE_BUCKETS];
+    lvm_CachedProgram *lru_head;
+    lvm_CachedProgram *lru_tail;
+    size_t size;
+    size_t limit;
+} lvm_program_cache = { .lock = LVM_MUTEX_INIT, .limit = LVM_PROGRAM_CACHE_LIMIT };
+
+// NOTE: Word-wise, the instructions are folded with XXH64 rounds into the seed of the memory hash,
+//       so hashing a full LVM_MEMORY_MAX image costs about as much as copying it
+LVM_API uint64_t lvm_program_hash(lvm_Program program) {
+    uint64_t hash = (uint64_t)program.insts_count * LVM_XXH_PRIME64_5;
+
+    for (size_t i = 0; i < program.insts_count; i++) {
+        hash = lvm_xxh64_round(hash, (uint64_t)program.insts[i].type);
+        hash = lvm_xxh64_round(hash, program.insts[i].operand.as_u64);
+    }
+
+    return lvm_hash64(program.memory, program.memory_size, hash);
+}
+
+// NOTE: Takes the high half of the hash, the low bits of a word-wise hash are the weakest ones
+static inline size_t lvm_program_cache_bucket(uint64_t hash) {
+    return (size_t)((hash >> 32) % LVM_PROGRAM_CACHE_BUCKETS);
+}
+
+static bool lvm_program_equals(lvm_Program a, lvm_Program b) {
+    if (a.insts_count != b.insts_count || a.memory_size != b.memory_size) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.insts_count; i++) {
+        if (a.insts[i].type != b.insts[i].type || a.insts[i].operand.as_u64 != b.insts[i].operand.as_u64) {
+            return false;
+        }
+    }
+
+    return a.memory_size == 0 || memcmp(a.memory, b.memory, a.memory_size) == 0;
+}
+
+static void lvm_program_cache_lru_unlink(lvm_CachedProgram *cached) {
+    if (cached->lru_prev != NULL) {
+        cached->lru_prev->lru_next = cached->lru_next;
+    } else {
+        lvm_program_cache.lru_head = cached->lru_next;
+    }
+
+    if (cached->lru_next != NULL) {
+        cached->lru_next->lru_prev = cached->lru_prev;
+    } else {
+        lvm_program_cache.lru_tail = cached->lru_prev;
+    }
+
+    cached->lru_prev = NULL;
+    cached->lru_next = NULL;
+}
+
+static void lvm_program_cache_lru_push_front(lvm_CachedProgram *cached) {
+    cached->lru_prev = NULL;
+    cached->lru_next = lvm_program_cache.lru_head;
+
+    if (lvm_program_cache.lru_head != NULL) {
+        lvm_program_cache.lru_head->lru_prev = cached;
+    } else {
+        lvm_program_cache.lru_tail = cached;
+    }
+
+    lvm_program_cache.lru_head = cached;
+}
+
+// NOTE: Must be called with the cache lock held, the reference owned by the cache is handed back to the caller
+static lvm_CachedProgram *lvm_program_cache_remove(lvm_CachedProgram *cached) {
+    lvm_CachedProgram **link = &lvm_program_cache.buckets[lvm_program_cache_bucket(cached->hash)];
+
+    while (*link != cached) {
+        link = &(*link)->bucket_next;
+    }
+
+    *link = cached->bucket_next;
+    cached->bucket_next = NULL;
+
+    lvm_program_cache_lru_unlink(cached);
+    lvm_program_cache.size -= cached->size;
+    cached->cached = false;
+
+    return cached;
+}
+
+// NOTE: Must be called with the cache lock held, returns the evicted entries chained through bucket_next
+static lvm_CachedProgram *lvm_program_cache_evict(size_t limit) {
+    lvm_CachedProgram *evicted = NULL;
+
+    while (lvm_program_cache.size > limit && lvm_program_cache.lru_tail != NULL) {
+        lvm_CachedProgram *cached = lvm_program_cache_remove(lvm_program_cache.lru_tail);
+
+        cached->bucket_next = evicted;
+        evicted = cached;
+    }
+
+    return evicted;
+}
+
+static void lvm_program_cache_release_all(lvm_CachedProgram *cached) {
+    while (cached != NULL) {
+        lvm_CachedProgram *next = cached->bucket_next;
+
+        lvm_program_cache_release(cached);
+        cached = next;
+    }
+}
+
+static lvm_CachedProgram *lvm_cached_program_create(lvm_Program program, uint64_t hash) {
+    size_t insts_size = program.insts_count * sizeof(*program.insts);
+    lvm_CachedProgram *cached = malloc(sizeof(*cached) + insts_size + program.memory_size);
+
+    assert(cached != NULL && "Illegal pointer(NULL)");
+
+    memset(cached, 0, sizeof(*cached));
+
+    lvm_Inst *insts = (lvm_Inst *)(cached + 1);
+    uint8_t *memory = (uint8_t *)insts + insts_size;
+
+    if (insts_size != 0) {
+        memcpy(insts, program.insts, insts_size);
+    }
+
+    if (program.memory_size != 0) {
+        memcpy(memory, program.memory, program.memory_size);
+    }
+
+    atomic_init(&cached->refs, 1);
+    cached->hash = hash;
+    cached->size = sizeof(*cached) + insts_size + program.memory_size;
+    cached->program = lvm_create_program(insts, program.insts_count, program.memory_size != 0 ? memory : NULL, program.memory_size);
+
+    return cached;
+}
+
+LVM_API lvm_CachedProgram *lvm_program_cache_acquire(lvm_Program program) {
+    assert(program.insts != NULL && "Illegal pointer(NULL)");
+    assert(!(program.memory == NULL && program.memory_size != 0) && "Illegal pointer(NULL)");
+
+    uint64_t hash = lvm_program_hash(program);
+    size_t bucket = lvm_program_cache_bucket(hash);
+
+    lvm_mutex_lock(&lvm_program_cache.lock);
+
+    for (lvm_CachedProgram *cached = lvm_program_cache.buckets[bucket]; cached != NULL; cached = cached->bucket_next) {
+        if (cached->hash == hash && lvm_program_equals(cached->program, program)) {
+            atomic_fetch_add_explicit(&cached->refs, 1, memory_order_relaxed);
+            lvm_program_cache_lru_unlink(cached);
+            lvm_program_cache_lru_push_front(cached);
+
+            lvm_mutex_unlock(&lvm_program_cache.lock);
+
+            return cached;
+        }
+    }
+
+    lvm_mutex_unlock(&lvm_program_cache.lock);
+
+    // NOTE: The copy is made outside of the lock, if another thread inserted the same program
+    //       in the meantime its entry wins and ours is dropped
+    lvm_CachedProgram *created = lvm_cached_program_create(program, hash);
+
+    lvm_mutex_lock(&lvm_program_cache.lock);
+
+    if (created->size > lvm_program_cache.limit) {
+        lvm_mutex_unlock(&lvm_program_cache.lock);
+
+        return created;
+    }
+
+    for (lvm_CachedProgram *cached = lvm_program_cache.buckets[bucket]; cached != NULL; cached = cached->bucket_next) {
+        if (cached->hash == hash && lvm_program_equals(cached->program, program)) {
+            atomic_fetch_add_explicit(&cached->refs, 1, memory_order_relaxed);
+
+            lvm_mutex_unlock(&lvm_program_cache.lock);
+
+            free(created);
+
+            return cached;
+        }
+    }
+
+    atomic_fetch_add_explicit(&created->refs, 1, memory_order_relaxed);
+    created->cached = true;
+    created->bucket_next = lvm_program_cache.buckets[bucket];
+    lvm_program_cache.buckets[bucket] = created;
+    lvm_program_cache_lru_push_front(created);
+    lvm_program_cache.size += created->size;
+
+    lvm_CachedProgram *evicted = lvm_program_cache_evict(lvm_program_cache.limit);
+
+    lvm_mutex_unlock(&lvm_program_cache.lock);
+
+    lvm_program_cache_release_all(evicted);
+
+    return created;
+}
+
+LVM_API lvm_CachedProgram *lvm_program_cache_retain(lvm_CachedProgram *cached) {
+    assert(cached != NULL && "Illegal pointer(NULL)");
+
+    atomic_fetch_add_explicit(&cached->refs, 1, memory_order_relaxed);
+
+    return cached;
+}
+
+LVM_API void lvm_program_cache_release(lvm_CachedProgram *cached) {
+    assert(cached != NULL && "Illegal pointer(NULL)");
+
+    if (atomic_fetch_sub_explicit(&cached->refs, 1, memory_order_acq_rel) == 1) {
+        assert(!cached->cached && "Illegal release of a cached program");
+        free(cached);
+    }
+}
+
+LVM_API lvm_Program lvm_cached_program_get(const lvm_CachedProgram *cached) {
+    assert(cached != NULL && "Illegal pointer(NULL)");
+
+    return cached->program;
+}
+
+LVM_API void lvm_program_cache_set_limit(size_t limit) {
+    lvm_mutex_lock(&lvm_program_cache.lock);
+
+    lvm_program_cache.limit = limit;
+    lvm_CachedProgram *evicted = lvm_program_cache_evict(limit);
+
+    lvm_mutex_unlock(&lvm_program_cache.lock);
+
+    lvm_program_cache_release_all(evicted);
+}
+
+LVM_API void lvm_program_cache_clear(void) {
+    lvm_mutex_lock(&lvm_program_cache.lock);
+
+    lvm_CachedProgram *evicted = lvm_program_cache_evict(0);
+
+    lvm_mutex_unlock(&lvm_program_cache.lock);
+
+    lvm_program_cache_release_all(evicted);
+}
+
+const char *const lvm_perf_counters_names[LVM_MAX_PERF_COUNTERS] = {
+    [LVM_PERF_CYCLES]        = "cycles",
+    [LVM_PERF_INSTRUCTIONS]  = "instructions",
+    [LVM_PERF_BRANCH_MISSES] = "branch_misses",
+    [LVM_PERF_L1D_MISSES]    = "l1d_misses",
+    [LVM_PERF_LLC_MISSES]    = "llc_misses",
+};
+
+LVM_API const char *lvm_get_perf_counter_name(lvm_PerfCounter counter) {
+    assert((uint32_t)counter < LVM_MAX_PERF_COUNTERS && "Illegal perf counter value");
+
+    return lvm_perf_counters_names[counter];
+}
+
+#ifdef LVM_HAS_PERF
+#define LVM_PERF_CACHE_MISS(CACHE) \
+    ((CACHE) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} lvm_perf_events[LVM_MAX_PERF_COUNTERS] = {
+    [LVM_PERF_CYCLES]        = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    [LVM_PERF_INSTRUCTIONS]  = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    [LVM_PERF_BRANCH_MISSES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    [LVM_PERF_L1D_MISSES]    = { PERF_TYPE_HW_CACHE, LVM_PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D) },
+    [LVM_PERF_LLC_MISSES]    = { PERF_TYPE_HW_CACHE, LVM_PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_LL) },
+};
+
+static int lvm_perf_open(lvm_PerfCounter counter, int leader) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = lvm_perf_events[counter].type;
+    attr.config = lvm_perf_events[counter].config;
+    attr.disabled = leader < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+}
+#endif
+
+LVM_API lvm_Trap lvm_machine_run_perf(lvm_Machine *machine, int64_t limit, lvm_PerfReport *report) {
+    assert(machine != NULL && "Illegal pointer(NULL)");
+    assert(report != NULL && "Illegal pointer(NULL)");
+
+    memset(report, 0, sizeof(*report));
+
+    uint64_t spawned_insts = machine->spawned_insts;
+
+#ifdef LVM_HAS_PERF
+    // NOTE: The counters form one group led by the first one that opens (cycles when the PMU has it),
+    //       so they are always scheduled together and every ratio between them is over the same window
+    int fds[LVM_MAX_PERF_COUNTERS];
+    lvm_PerfCounter members[LVM_MAX_PERF_COUNTERS];
+    size_t members_count = 0;
+    int leader = -1;
+
+    for (size_t i = 0; i < LVM_MAX_PERF_COUNTERS; i++) {
+        fds[i] = lvm_perf_open((lvm_PerfCounter)i, leader);
+
+        if (fds[i] >= 0) {
+            if (leader < 0) {
+                leader = fds[i];
+            }
+
+            members[members_count++] = (lvm_PerfCounter)i;
+        }
+    }
+
+    if (leader >= 0) {
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    report->trap = lvm_machine_run_counted(machine, limit, &report->guest_insts);
+
+    if (leader >= 0) {
+        ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+        // NOTE: PERF_FORMAT_GROUP layout: nr, time_enabled, time_running, then one value per member in open order.
+        //       If the group had to be multiplexed all values are scaled by the same enabled/running ratio
+        uint64_t data[3 + LVM_MAX_PERF_COUNTERS];
+        ssize_t size = (ssize_t)((3 + members_count) * sizeof(data[0]));
+
+        if (read(leader, data, (size_t)size) == size && data[0] == members_count && data[2] != 0) {
+            double scale = (double)data[1] / (double)data[2];
+
+            for (size_t i = 0; i < members_count; i++) {
+                report->values[members[i]] = data[1] == data[2] ? data[3 + i] : (uint64_t)((double)data[3 + i] * scale);
+                report->available[members[i]] = true;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < LVM_MAX_PERF_COUNTERS; i++) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+#else
+    report->trap = lvm_machine_run_counted(machine, limit, &report->guest_insts);
+#endif
+
+    report->child_insts = machine->spawned_insts - spawned_insts;
+
+    return report->trap;
+}
+
+LVM_API double lvm_perf_per_guest_inst(const lvm_PerfReport *report, lvm_PerfCounter counter) {
+    assert(report != NULL && "Illegal pointer(NULL)");
+    assert((uint32_t)counter < LVM_MAX_PERF_COUNTERS && "Illegal perf counter value");
+
+    if (!report->available[counter] || report->guest_insts == 0) {
+        return NAN;
+    }
+
+    return (double)report->values[counter] / (double)report->guest_insts;
+}
+
+LVM_API void lvm_perf_dump_csv_header(FILE *stream) {
+    fprintf(stream, "trap,guest_insts,child_insts");
+
+    for (size_t i = 0; i < LVM_MAX_PERF_COUNTERS; i++) {
+        fprintf(stream, ",%s", lvm_perf_counters_names[i]);
+    }
+
+    for (size_t i = 0; i < LVM_MAX_PERF_COUNTERS; i++) {
+        fprintf(stream, ",%s_per_inst", lvm_perf_counters_names[i]);
+    }
+
+    fprintf(stream, "\n");
+}
+
+// NOTE: Unavailable counters are written as empty fields
+LVM_API void lvm_perf_dump_csv(const lvm_PerfReport *report, FILE *stream) {
+    assert(report != NULL && "Illegal pointer(NULL)");
+
+    fprintf(stream, "%s,%"PRIu64",%"PRIu64, lvm_get_trap_name(report->trap), report->guest_insts, report->child_insts);
+
+    for (size_t i = 0; i < LVM_MAX_PERF_COUNTERS; i++) {
+        if (report->available[i]) {
+            fprintf(stream, ",%"PRIu64, report->values[i]);
+        } else {
+            fprintf(stream, ",");
+        }
+    }
+
+    for (size_t i = 0; i < LVM_MAX_PERF_COUNTERS; i++) {
+        if (report->available[i] && report->guest_insts != 0) {
+            fprintf(stream, ",%.4f", lvm_perf_per_guest_inst(report, (lvm_PerfCounter)i));
+        } else {
+            fprintf(stream, ",");
+        }
+    }
+
+    fprintf(stream, "\n");
 }
 
 #endif